@@ -7,13 +7,317 @@
 #include <string_view>
 #include <algorithm>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <bit>
 #include <sstream>
 #include <charconv>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+
+#if !defined(GHASSANPL_STRING_OPS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GHASSANPL_STRING_OPS_SSE2 1
+#include <emmintrin.h>
+#else
+#define GHASSANPL_STRING_OPS_SSE2 0
+#endif
+
+#if !defined(GHASSANPL_STRING_OPS_NO_SIMD) && (defined(__SSSE3__) || defined(__AVX__))
+#define GHASSANPL_STRING_OPS_SSSE3 1
+#include <tmmintrin.h>
+#else
+#define GHASSANPL_STRING_OPS_SSSE3 0
+#endif
+
+#if defined(__clang__)
+#define GHASSANPL_STRING_OPS_TRIVIAL_ABI [[clang::trivial_abi]]
+#else
+#define GHASSANPL_STRING_OPS_TRIVIAL_ABI
+#endif
+
+#ifndef GHASSANPL_STRING_OPS_STATS
+#define GHASSANPL_STRING_OPS_STATS 0
+#endif
+
+#if GHASSANPL_STRING_OPS_STATS
+#include <mutex>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 namespace ghassanpl::string_ops
 {
 	using std::string_view;
 
+	namespace detail
+	{
+		template <typename T>
+		concept allocator = requires (T& alloc) {
+			typename T::value_type;
+			alloc.deallocate(alloc.allocate(size_t{ 1 }), size_t{ 1 });
+		};
+
+		template <typename ALLOC, typename T>
+		using rebind_alloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<T>;
+
+		/// The string type produced by the allocator-aware overloads
+		template <typename ALLOC>
+		using string_for = std::basic_string<char, std::char_traits<char>, rebind_alloc<ALLOC, char>>;
+	}
+
+	/// ///////////////////////////// ///
+	/// Instrumentation
+	/// ///////////////////////////// ///
+
+	/// Define GHASSANPL_STRING_OPS_STATS to 1 to have the functions below record per-thread call counts, bytes processed,
+	/// allocations made for the containers they return, and a histogram of call durations (in cycles where available).
+	/// When it is 0 (the default), the recording macros expand to nothing.
+	namespace stats
+	{
+		enum class function_id
+		{
+			tolower, toupper, make_string, consume_c_string, split, natural_split, join, join_and,
+			hex_encode, hex_decode, base64_encode, base64_decode, string_builder_block,
+			make_sort_key, sort_by_key, sort_strings, edit_distance, fuzzy_lookup,
+			count
+		};
+
+		[[nodiscard]] inline constexpr string_view name(function_id function) noexcept
+		{
+			constexpr string_view names[] = {
+				"tolower", "toupper", "make_string", "consume_c_string", "split", "natural_split", "join", "join_and",
+				"hex_encode", "hex_decode", "base64_encode", "base64_decode", "string_builder_block",
+				"make_sort_key", "sort_by_key", "sort_strings", "edit_distance", "fuzzy_lookup",
+			};
+			static_assert(std::size(names) == size_t(function_id::count));
+			return names[size_t(function)];
+		}
+
+		struct function_stats
+		{
+			/// Bucket `i` counts calls that took [2^i, 2^(i+1)) cycles; the last bucket also counts anything longer
+			static constexpr size_t histogram_buckets = 40;
+
+			uint64_t calls = 0;
+			uint64_t bytes = 0;
+			uint64_t allocations = 0;
+			uint64_t cycles = 0;
+			uint64_t cycle_histogram[histogram_buckets]{};
+		};
+
+		struct report
+		{
+			function_stats functions[size_t(function_id::count)]{};
+
+			[[nodiscard]] function_stats const& operator[](function_id function) const noexcept { return functions[size_t(function)]; }
+		};
+	}
+
+#if GHASSANPL_STRING_OPS_STATS
+	namespace detail
+	{
+		[[nodiscard]] inline uint64_t cycle_count() noexcept
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+		}
+
+		/// Written only by the owning thread (with relaxed load+store, so no locked instructions), read by `stats::snapshot()`
+		struct thread_function_counters
+		{
+			std::atomic<uint64_t> calls{ 0 }, bytes{ 0 }, allocations{ 0 }, cycles{ 0 };
+			std::atomic<uint64_t> cycle_histogram[stats::function_stats::histogram_buckets]{};
+		};
+
+		struct thread_counters
+		{
+			thread_function_counters functions[size_t(stats::function_id::count)];
+		};
+
+		inline void add_counter(std::atomic<uint64_t>& counter, uint64_t value) noexcept { counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+
+		inline void accumulate(stats::report& into, thread_counters const& from) noexcept
+		{
+			for (size_t f = 0; f < size_t(stats::function_id::count); ++f)
+			{
+				auto& to = into.functions[f];
+				auto& counters = from.functions[f];
+				to.calls += counters.calls.load(std::memory_order_relaxed);
+				to.bytes += counters.bytes.load(std::memory_order_relaxed);
+				to.allocations += counters.allocations.load(std::memory_order_relaxed);
+				to.cycles += counters.cycles.load(std::memory_order_relaxed);
+				for (size_t b = 0; b < stats::function_stats::histogram_buckets; ++b)
+					to.cycle_histogram[b] += counters.cycle_histogram[b].load(std::memory_order_relaxed);
+			}
+		}
+
+		struct registered_thread_counters;
+
+		struct stats_registry
+		{
+			std::mutex mutex;
+			registered_thread_counters* live_threads = nullptr; /// intrusive list, so registering a thread never allocates
+			stats::report exited_threads;
+			stats::report baseline; /// subtracted from snapshots, so `reset()` never has to write to another thread's counters
+		};
+
+		inline stats_registry& registry()
+		{
+			static stats_registry instance;
+			return instance;
+		}
+
+		struct registered_thread_counters : thread_counters
+		{
+			registered_thread_counters()
+			{
+				auto& reg = registry();
+				std::lock_guard lock{ reg.mutex };
+				next = reg.live_threads;
+				if (next)
+					next->previous = this;
+				reg.live_threads = this;
+			}
+
+			~registered_thread_counters()
+			{
+				auto& reg = registry();
+				std::lock_guard lock{ reg.mutex };
+				accumulate(reg.exited_threads, *this);
+				(previous ? previous->next : reg.live_threads) = next;
+				if (next)
+					next->previous = previous;
+			}
+
+			registered_thread_counters* previous = nullptr;
+			registered_thread_counters* next = nullptr;
+		};
+
+		inline thread_counters& this_thread_counters()
+		{
+			thread_local registered_thread_counters counters;
+			return counters;
+		}
+
+		class stats_scope
+		{
+		public:
+
+			stats_scope(stats::function_id function, size_t processed_bytes) noexcept : bytes(processed_bytes), m_function(function), m_start(cycle_count()) {}
+			stats_scope(stats_scope const&) = delete;
+			stats_scope& operator=(stats_scope const&) = delete;
+
+			~stats_scope()
+			{
+				const auto cycles = cycle_count() - m_start;
+				auto& counters = this_thread_counters().functions[size_t(m_function)];
+				add_counter(counters.calls, 1);
+				add_counter(counters.bytes, bytes);
+				add_counter(counters.allocations, allocations);
+				add_counter(counters.cycles, cycles);
+				add_counter(counters.cycle_histogram[std::min<size_t>(std::bit_width(cycles), stats::function_stats::histogram_buckets) - (cycles != 0)], 1);
+			}
+
+			size_t bytes = 0;
+			size_t allocations = 0;
+
+		private:
+
+			stats::function_id m_function;
+			uint64_t m_start;
+		};
+
+		/// Whether `str` had to allocate, i.e. its contents did not fit in the small string buffer
+		template <typename STRING>
+		[[nodiscard]] bool heap_allocated(STRING const& str) { return str.capacity() > STRING(str.get_allocator()).capacity(); }
+	}
+
+/// Also used in `noexcept` functions. The first scope on a thread registers it, which does not allocate but does lock the registry mutex;
+/// if that lock throws (`std::system_error`, which the standard allows), the program terminates.
+#define GHASSANPL_STRING_OPS_STATS_SCOPE(function, bytes) ::ghassanpl::string_ops::detail::stats_scope ghassanpl_string_ops_stats_scope_{ ::ghassanpl::string_ops::stats::function_id::function, size_t(bytes) }
+#define GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(count) (ghassanpl_string_ops_stats_scope_.allocations += size_t(count))
+#define GHASSANPL_STRING_OPS_STATS_BYTES(count) (ghassanpl_string_ops_stats_scope_.bytes = size_t(count))
+#else
+#define GHASSANPL_STRING_OPS_STATS_SCOPE(function, bytes) ((void)0)
+#define GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(count) ((void)0)
+#define GHASSANPL_STRING_OPS_STATS_BYTES(count) ((void)0)
+#endif
+
+	namespace stats
+	{
+		/// Totals over all threads (including ones that have exited) since the start of the program or the last `reset()`.
+		/// Always empty if GHASSANPL_STRING_OPS_STATS is 0.
+		[[nodiscard]] inline report snapshot()
+		{
+			report result;
+#if GHASSANPL_STRING_OPS_STATS
+			auto& reg = detail::registry();
+			std::lock_guard lock{ reg.mutex };
+			result = reg.exited_threads;
+			for (auto counters = reg.live_threads; counters; counters = counters->next)
+				detail::accumulate(result, *counters);
+			for (size_t f = 0; f < size_t(function_id::count); ++f)
+			{
+				auto& to = result.functions[f];
+				auto& base = reg.baseline.functions[f];
+				to.calls -= base.calls;
+				to.bytes -= base.bytes;
+				to.allocations -= base.allocations;
+				to.cycles -= base.cycles;
+				for (size_t b = 0; b < function_stats::histogram_buckets; ++b)
+					to.cycle_histogram[b] -= base.cycle_histogram[b];
+			}
+#endif
+			return result;
+		}
+
+		inline void reset()
+		{
+#if GHASSANPL_STRING_OPS_STATS
+			auto& reg = detail::registry();
+			std::lock_guard lock{ reg.mutex };
+			reg.baseline = reg.exited_threads;
+			for (auto counters = reg.live_threads; counters; counters = counters->next)
+				detail::accumulate(reg.baseline, *counters);
+#endif
+		}
+
+		/// One line per function that was called: `name calls=N bytes=N allocations=N cycles=N histogram=bucket:count,...`
+		inline void dump(std::ostream& out, report const& data)
+		{
+			for (size_t f = 0; f < size_t(function_id::count); ++f)
+			{
+				auto& stats = data.functions[f];
+				if (stats.calls == 0)
+					continue;
+				out << name(function_id(f)) << " calls=" << stats.calls << " bytes=" << stats.bytes << " allocations=" << stats.allocations << " cycles=" << stats.cycles << " histogram=";
+				bool first = true;
+				for (size_t b = 0; b < function_stats::histogram_buckets; ++b)
+				{
+					if (!stats.cycle_histogram[b])
+						continue;
+					if (!first) out << ',';
+					out << b << ':' << stats.cycle_histogram[b];
+					first = false;
+				}
+				out << '\n';
+			}
+		}
+	}
+
 	/// ///////////////////////////// ///
 	/// ASCII functions
 	/// ///////////////////////////// ///
@@ -40,10 +344,48 @@ namespace ghassanpl::string_ops
 		[[nodiscard]] inline constexpr char32_t tolower(char32_t cp) noexcept { return (cp >= 'A' && cp <= 'Z') ? (cp | 0b100000) : cp; }
 
 		[[nodiscard]] inline std::string tolower(std::string str) noexcept { std::for_each(str.begin(), str.end(), [](char& cp) { cp = (char)tolower(cp); }); return str; }
-		[[nodiscard]] inline std::string tolower(std::string_view str) noexcept { return tolower(std::string{str}); }
+		[[nodiscard]] inline std::string tolower(std::string_view str) noexcept
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(tolower, str.size());
+			auto result = tolower(std::string{ str });
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+			return result;
+		}
 
 		[[nodiscard]] inline std::string toupper(std::string str) noexcept { std::for_each(str.begin(), str.end(), [](char& cp) { cp = (char)toupper(cp); }); return str; }
-		[[nodiscard]] inline std::string toupper(string_view str) noexcept { return toupper(std::string{str}); }
+		[[nodiscard]] inline std::string toupper(string_view str) noexcept
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(toupper, str.size());
+			auto result = toupper(std::string{ str });
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+			return result;
+		}
+
+		/// Allocator-aware versions
+		template <detail::allocator ALLOC>
+		[[nodiscard]] inline detail::string_for<ALLOC> tolower(string_view str, ALLOC const& alloc)
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(tolower, str.size());
+			detail::string_for<ALLOC> result(str, alloc);
+			std::for_each(result.begin(), result.end(), [](char& cp) { cp = (char)tolower(cp); });
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+			return result;
+		}
+		template <detail::allocator ALLOC>
+		[[nodiscard]] inline detail::string_for<ALLOC> toupper(string_view str, ALLOC const& alloc)
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(toupper, str.size());
+			detail::string_for<ALLOC> result(str, alloc);
+			std::for_each(result.begin(), result.end(), [](char& cp) { cp = (char)toupper(cp); });
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+			return result;
+		}
+
+		/// Versions that reuse the storage of a caller-owned string (`out` is overwritten)
+		template <typename TRAITS, typename ALLOC>
+		inline std::basic_string<char, TRAITS, ALLOC>& tolower(string_view str, std::basic_string<char, TRAITS, ALLOC>& out) { out.assign(str); std::for_each(out.begin(), out.end(), [](char& cp) { cp = (char)tolower(cp); }); return out; }
+		template <typename TRAITS, typename ALLOC>
+		inline std::basic_string<char, TRAITS, ALLOC>& toupper(string_view str, std::basic_string<char, TRAITS, ALLOC>& out) { out.assign(str); std::for_each(out.begin(), out.end(), [](char& cp) { cp = (char)toupper(cp); }); return out; }
 
 		[[nodiscard]] inline constexpr char32_t todigit(int v) noexcept { return char32_t(v) + U'0'; }
 		[[nodiscard]] inline constexpr char32_t toxdigit(int v) noexcept { return (v > 9) ? (char32_t(v - 10) + U'A') : (char32_t(v) + U'0'); }
@@ -55,7 +397,7 @@ namespace ghassanpl::string_ops
 
 		[[nodiscard]] constexpr bool lexicographical_compare_ignore_case(string_view a, string_view b)
 		{
-			return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char a, char b) { return toupper(a) == toupper(b); });
+			return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char a, char b) { return toupper(a) < toupper(b); });
 		}
 
 	}
@@ -68,9 +410,20 @@ namespace ghassanpl::string_ops
 	template <std::contiguous_iterator IT, typename T = typename std::iterator_traits<IT>::value_type>
 	[[nodiscard]] inline constexpr string_view make_sv(IT start, IT end) { return string_view{ std::to_address(start), static_cast<size_t>(std::distance(std::to_address(start), std::to_address(end))) }; }
 
-	[[nodiscard]] inline std::string make_string(const char* start, const char* end) { return std::string{ start, static_cast<size_t>(end - start) }; }
+	template <detail::allocator ALLOC>
+	[[nodiscard]] inline detail::string_for<ALLOC> make_string(const char* start, const char* end, ALLOC const& alloc)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(make_string, end - start);
+		detail::string_for<ALLOC> result(start, static_cast<size_t>(end - start), alloc);
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+		return result;
+	}
+	template <std::contiguous_iterator IT, detail::allocator ALLOC>
+	[[nodiscard]] inline detail::string_for<ALLOC> make_string(IT start, IT end, ALLOC const& alloc) { return make_string(static_cast<const char*>(std::to_address(start)), static_cast<const char*>(std::to_address(end)), alloc); }
+
+	[[nodiscard]] inline std::string make_string(const char* start, const char* end) { return make_string(start, end, std::allocator<char>{}); }
 	template <std::contiguous_iterator IT, typename T = typename std::iterator_traits<IT>::value_type>
-	[[nodiscard]] inline std::string make_string(IT start, IT end) { return std::string{ std::to_address(start), static_cast<size_t>(std::distance(std::to_address(start), std::to_address(end))) }; }
+	[[nodiscard]] inline std::string make_string(IT start, IT end) { return make_string(static_cast<const char*>(std::to_address(start)), static_cast<const char*>(std::to_address(end)), std::allocator<char>{}); }
 
 	/// for predicates
 	[[nodiscard]] inline std::string to_string(string_view from) noexcept { return std::string{ from }; }
@@ -79,9 +432,165 @@ namespace ghassanpl::string_ops
 	/// Trims
 	/// ///////////////////////////// ///
 
-	[[nodiscard]] inline string_view trimmed_whitespace_right(string_view str) noexcept { return make_sv(str.begin(), std::find_if_not(str.rbegin(), str.rend(), ::ghassanpl::string_ops::ascii::isspace).base()); }
-	[[nodiscard]] inline string_view trimmed_whitespace_left(string_view str) noexcept { return make_sv(std::find_if_not(str.begin(), str.end(), ::ghassanpl::string_ops::ascii::isspace), str.end()); }
+	namespace detail
+	{
+		/// Same set as `ascii::isspace`, with two comparisons instead of six
+		[[nodiscard]] inline constexpr bool is_whitespace_byte(char c) noexcept { return c == ' ' || uint8_t(c - '\t') <= uint8_t('\r' - '\t'); }
+
+#if GHASSANPL_STRING_OPS_SSE2
+		/// 0xFF for every whitespace byte of `v`
+		[[nodiscard]] inline __m128i whitespace_bytes(__m128i v) noexcept
+		{
+			const __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+			const __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+			return _mm_or_si128(is_control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+		}
+
+		/// Bit `i` is set if byte `i` of `v` is whitespace
+		[[nodiscard]] inline uint32_t whitespace_mask(__m128i v) noexcept { return uint32_t(_mm_movemask_epi8(whitespace_bytes(v))); }
+#endif
+
+#if GHASSANPL_STRING_OPS_SSSE3
+		/// For every 8-bit keep mask, the `pshufb` indices that move the kept bytes to the front
+		struct compaction_table { uint8_t indices[256][8]; };
+		inline constexpr compaction_table compaction_indices = [] {
+			compaction_table result{};
+			for (int mask = 0; mask < 256; ++mask)
+			{
+				int out = 0;
+				for (int i = 0; i < 8; ++i)
+					if (mask & (1 << i))
+						result.indices[mask][out++] = uint8_t(i);
+			}
+			return result;
+		}();
+#endif
+
+		[[nodiscard]] inline const char* skip_whitespace(const char* begin, const char* end) noexcept
+		{
+			/// Most fields have no leading whitespace at all
+			if (begin == end || !is_whitespace_byte(*begin))
+				return begin;
+#if GHASSANPL_STRING_OPS_SSE2
+			for (; end - begin >= 16; begin += 16)
+			{
+				if (const auto mask = whitespace_mask(_mm_loadu_si128((const __m128i*)begin)); mask != 0xFFFF)
+					return begin + std::countr_one(mask);
+			}
+#endif
+			while (begin != end && is_whitespace_byte(*begin))
+				++begin;
+			return begin;
+		}
+
+		/// Returns the new end
+		[[nodiscard]] inline const char* skip_whitespace_backwards(const char* begin, const char* end) noexcept
+		{
+			if (begin == end || !is_whitespace_byte(end[-1]))
+				return end;
+#if GHASSANPL_STRING_OPS_SSE2
+			for (; end - begin >= 16; end -= 16)
+			{
+				if (const auto mask = whitespace_mask(_mm_loadu_si128((const __m128i*)(end - 16))); mask != 0xFFFF)
+					return end - std::countl_one(uint16_t(mask));
+			}
+#endif
+			while (begin != end && is_whitespace_byte(end[-1]))
+				--end;
+			return end;
+		}
+	}
+
+	[[nodiscard]] inline string_view trimmed_whitespace_right(string_view str) noexcept { return make_sv(str.data(), detail::skip_whitespace_backwards(str.data(), str.data() + str.size())); }
+	[[nodiscard]] inline string_view trimmed_whitespace_left(string_view str) noexcept { return make_sv(detail::skip_whitespace(str.data(), str.data() + str.size()), str.data() + str.size()); }
 	[[nodiscard]] inline string_view trimmed_whitespace(string_view str) noexcept { return trimmed_whitespace_left(trimmed_whitespace_right(str)); }
+
+	/// Trims every element of `fields` in place
+	inline void trim_all(std::span<string_view> fields) noexcept
+	{
+		for (auto& field : fields)
+		{
+			const auto begin = field.data();
+			const auto end = detail::skip_whitespace_backwards(begin, begin + field.size());
+			field = make_sv(detail::skip_whitespace(begin, end), end);
+		}
+	}
+
+	/// Replaces every run of whitespace in `str` with a single space, writing the result to `out` (which needs room for `str.size()` chars).
+	/// `out` may point to `str.data()` for in-place use. Returns the end of the written range.
+	/// Leading and trailing runs are kept (as one space each); use `trimmed_whitespace` first to drop them.
+	inline char* collapse_whitespace(string_view str, char* out) noexcept
+	{
+		auto in = str.data();
+		auto const end = in + str.size();
+		bool previous_was_space = false;
+
+#if GHASSANPL_STRING_OPS_SSE2
+		for (; end - in >= 16; in += 16)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)in);
+			const __m128i is_whitespace = detail::whitespace_bytes(v);
+			const auto whitespace = uint32_t(_mm_movemask_epi8(is_whitespace));
+			if (whitespace == 0)
+			{
+				_mm_storeu_si128((__m128i*)out, v);
+				out += 16;
+				previous_was_space = false;
+				continue;
+			}
+
+			/// Keep every non-whitespace byte and the first byte of every whitespace run, the latter replaced by a space
+			const auto keep = (~whitespace | (whitespace & ~((whitespace << 1) | uint32_t(previous_was_space)))) & 0xFFFF;
+			previous_was_space = whitespace >> 15;
+
+			const __m128i normalized = _mm_or_si128(_mm_andnot_si128(is_whitespace, v), _mm_and_si128(is_whitespace, _mm_set1_epi8(' ')));
+#if GHASSANPL_STRING_OPS_SSSE3
+			/// Compact each half separately; the stores never reach past the 16 bytes just read, so this is safe in place
+			const __m128i indices = _mm_unpacklo_epi64(
+				_mm_loadl_epi64((const __m128i*)detail::compaction_indices.indices[keep & 0xFF]),
+				_mm_add_epi8(_mm_loadl_epi64((const __m128i*)detail::compaction_indices.indices[keep >> 8]), _mm_set1_epi8(8)));
+			const __m128i compacted = _mm_shuffle_epi8(normalized, indices);
+			_mm_storel_epi64((__m128i*)out, compacted);
+			out += std::popcount(keep & 0xFF);
+			_mm_storel_epi64((__m128i*)out, _mm_srli_si128(compacted, 8));
+			out += std::popcount(keep >> 8);
+#else
+			alignas(16) char normalized_bytes[16];
+			_mm_store_si128((__m128i*)normalized_bytes, normalized);
+			for (int i = 0; i < 16; ++i)
+			{
+				*out = normalized_bytes[i];
+				out += (keep >> i) & 1;
+			}
+#endif
+		}
+#endif
+
+		for (; in != end; ++in)
+		{
+			const bool space = detail::is_whitespace_byte(*in);
+			*out = space ? ' ' : *in;
+			out += !(space && previous_was_space);
+			previous_was_space = space;
+		}
+		return out;
+	}
+
+	/// In-place version; returns `str`
+	template <typename TRAITS, typename ALLOC>
+	inline std::basic_string<char, TRAITS, ALLOC>& collapse_whitespace(std::basic_string<char, TRAITS, ALLOC>& str) noexcept
+	{
+		str.resize(size_t(collapse_whitespace(string_view{ str }, str.data()) - str.data()));
+		return str;
+	}
+
+	[[nodiscard]] inline std::string collapsed_whitespace(string_view str)
+	{
+		std::string result(str.size(), '\0');
+		result.resize(size_t(collapse_whitespace(str, result.data()) - result.data()));
+		return result;
+	}
+
 	[[nodiscard]] inline string_view trimmed_until(string_view str, char chr) noexcept { return make_sv(std::find(str.begin(), str.end(), chr), str.end()); }
 
 	template <typename FUNC>
@@ -227,103 +736,137 @@ namespace ghassanpl::string_ops
 	}
 
 	size_t append_utf8(std::string& buffer, char32_t cp);
+	template <typename TRAITS, typename ALLOC>
+	size_t append_utf8(std::basic_string<char, TRAITS, ALLOC>& buffer, char32_t cp);
 
-	inline std::pair<string_view, std::string> consume_c_string(string_view& strv)
+	namespace detail
 	{
-		if (strv.empty() || strv[0] != '"')
-			return {};
-
-		std::pair<string_view, std::string> result;
-
-		auto view = strv;
-		auto start = view.begin();
-		view.remove_prefix(1);
-		while (view[0] != '"')
+		/// Decodes the C string literal at the start of `strv` into `out`, which needs `push_back(char)` and an `append_utf8` overload.
+		/// Returns the whole literal (including quotes), or an empty view if it is malformed, in which case `strv` is not modified.
+		template <typename OUTPUT>
+		string_view consume_c_string_into(string_view& strv, OUTPUT& out)
 		{
-			auto cp = consume(view);
-			if (cp == '\\')
-			{
-				cp = consume(view);
-				if (view.empty())
-					return {}; /// Unterminated string literal
+			if (strv.empty() || strv[0] != '"')
+				return {};
 
-				switch (cp)
-				{
-				case 'n': result.second += '\n'; break;
-				case '"': result.second += '"'; break;
-				case '\'': result.second += '\''; break;
-				case '\\': result.second += '\\'; break;
-				case 'b': result.second += '\b'; break;
-				case 'r': result.second += '\r'; break;
-				case 'f': result.second += '\f'; break;
-				case 't': result.second += '\t'; break;
-				case '0': result.second += '\0'; break;
-				case 'o':
+			auto view = strv;
+			auto start = view.begin();
+			view.remove_prefix(1);
+			while (!view.empty() && view[0] != '"')
+			{
+				auto cp = consume(view);
+				if (cp == '\\')
 				{
-					auto num = consume_n(view, 3);
-					if (num.size() < 3 || view.empty()) return {}; /// malformed
+					cp = consume(view);
+					if (view.empty())
+						return {}; /// Unterminated string literal
 
-					auto parsed = consume_c_integer(num, 8);
-					if (parsed.first.empty() || !num.empty()) return {}; /// malformed
+					switch (cp)
+					{
+					case 'n': out.push_back('\n'); break;
+					case '"': out.push_back('"'); break;
+					case '\'': out.push_back('\''); break;
+					case '\\': out.push_back('\\'); break;
+					case 'b': out.push_back('\b'); break;
+					case 'r': out.push_back('\r'); break;
+					case 'f': out.push_back('\f'); break;
+					case 't': out.push_back('\t'); break;
+					case '0': out.push_back('\0'); break;
+					case 'o':
+					{
+						auto num = consume_n(view, 3);
+						if (num.size() < 3 || view.empty()) return {}; /// malformed
 
-					if (parsed.second > 255) return {}; /// invalid octal
-					result.second.push_back((char)parsed.second);
-					break;
-				}
-				case 'x':
-				{
-					auto num = consume_n(view, 2);
-					if (num.size() < 2 || view.empty()) return {}; /// malformed
+						auto parsed = consume_c_integer(num, 8);
+						if (parsed.first.empty() || !num.empty()) return {}; /// malformed
 
-					auto parsed = consume_c_integer(num, 16);
-					if (parsed.first.empty() || !num.empty()) return {}; /// malformed
+						if (parsed.second > 255) return {}; /// invalid octal
+						out.push_back((char)parsed.second);
+						break;
+					}
+					case 'x':
+					{
+						auto num = consume_n(view, 2);
+						if (num.size() < 2 || view.empty()) return {}; /// malformed
 
-					append_utf8(result.second, (char32_t)parsed.second);
-					break;
-				}
-				case 'u':
-				{
-					auto num = consume_n(view, 4);
-					if (num.size() < 4 || view.empty()) return {}; /// malformed
+						auto parsed = consume_c_integer(num, 16);
+						if (parsed.first.empty() || !num.empty()) return {}; /// malformed
 
-					auto parsed = consume_c_integer(num, 16);
-					if (parsed.first.empty() || !num.empty()) return {}; /// malformed
+						append_utf8(out, (char32_t)parsed.second);
+						break;
+					}
+					case 'u':
+					{
+						auto num = consume_n(view, 4);
+						if (num.size() < 4 || view.empty()) return {}; /// malformed
 
-					append_utf8(result.second, (char32_t)parsed.second);
-					break;
-				}
-				case 'U':
-				{
-					auto num = consume_n(view, 8);
-					if (num.size() < 8 || view.empty()) return {}; /// malformed
+						auto parsed = consume_c_integer(num, 16);
+						if (parsed.first.empty() || !num.empty()) return {}; /// malformed
 
-					auto parsed = consume_c_integer(num, 16);
-					if (parsed.first.empty() || !num.empty()) return {}; /// malformed
+						append_utf8(out, (char32_t)parsed.second);
+						break;
+					}
+					case 'U':
+					{
+						auto num = consume_n(view, 8);
+						if (num.size() < 8 || view.empty()) return {}; /// malformed
 
-					append_utf8(result.second, (char32_t)parsed.second);
-					break;
+						auto parsed = consume_c_integer(num, 16);
+						if (parsed.first.empty() || !num.empty()) return {}; /// malformed
+
+						append_utf8(out, (char32_t)parsed.second);
+						break;
+					}
+					default:
+						return {}; /// unknown escape character
+					}
 				}
-				default:
-					return {}; /// unknown escape character
+				else
+				{
+					out.push_back(cp);
 				}
 			}
-			else
-			{
-				result.second += cp;
-			}
 
-			if (view.empty())
+			if (!consume(view, '"'))
 				return {}; /// unterminated
+
+			strv = view;
+			return make_sv(start, view.begin());
 		}
+	}
 
-		if (!consume(view, '"'))
-			return {}; /// unterminated
+	template <detail::allocator ALLOC>
+	inline std::pair<string_view, detail::string_for<ALLOC>> consume_c_string(string_view& strv, ALLOC const& alloc)
+	{
+		std::pair<string_view, detail::string_for<ALLOC>> result{ string_view{}, detail::string_for<ALLOC>(alloc) };
+		GHASSANPL_STRING_OPS_STATS_SCOPE(consume_c_string, 0);
+		result.first = detail::consume_c_string_into(strv, result.second);
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result.second));
+		GHASSANPL_STRING_OPS_STATS_BYTES(result.first.size());
+		if (result.first.empty())
+			result.second.clear();
+		return result;
+	}
 
-		result.first = make_sv(start, view.begin());
-		strv = view;
+	inline std::pair<string_view, std::string> consume_c_string(string_view& strv)
+	{
+		auto result = consume_c_string(strv, std::allocator<char>{});
+		if (result.first.empty())
+			return {};
 		return result;
 	}
 
+	/// Appends the decoded contents of the literal to `out` (nothing on failure) and returns the literal itself, or an empty view if it is malformed
+	template <typename TRAITS, typename ALLOC>
+	inline string_view consume_c_string(string_view& strv, std::basic_string<char, TRAITS, ALLOC>& out)
+	{
+		const auto previous_size = out.size();
+		const auto literal = detail::consume_c_string_into(strv, out);
+		if (literal.empty())
+			out.resize(previous_size);
+		return literal;
+	}
+
 	/// TODO: this 
 	void consume_c_literal(string_view& str);
 
@@ -363,79 +906,748 @@ namespace ghassanpl::string_ops
 		return cp;
 	}
 
+	namespace detail
+	{
+		/// Writes 1 to 4 bytes to `out`, assuming codepoint is valid
+		inline size_t encode_utf8(char32_t cp, char* out) noexcept
+		{
+			if (cp < 0x80)
+			{
+				out[0] = static_cast<char>(cp);
+				return 1;
+			}
+			else if (cp < 0x800)
+			{
+				out[0] = static_cast<char>((cp >> 6) | 0xc0);
+				out[1] = static_cast<char>((cp & 0x3f) | 0x80);
+				return 2;
+			}
+			else if (cp < 0x10000)
+			{
+				out[0] = static_cast<char>((cp >> 12) | 0xe0);
+				out[1] = static_cast<char>(((cp >> 6) & 0x3f) | 0x80);
+				out[2] = static_cast<char>((cp & 0x3f) | 0x80);
+				return 3;
+			}
+			else
+			{
+				out[0] = static_cast<char>((cp >> 18) | 0xf0);
+				out[1] = static_cast<char>(((cp >> 12) & 0x3f) | 0x80);
+				out[2] = static_cast<char>(((cp >> 6) & 0x3f) | 0x80);
+				out[3] = static_cast<char>((cp & 0x3f) | 0x80);
+				return 4;
+			}
+		}
+	}
+
 	/// Assuming codepoint is valid
-	inline size_t append_utf8(std::string& buffer, char32_t cp)
+	template <typename TRAITS, typename ALLOC>
+	inline size_t append_utf8(std::basic_string<char, TRAITS, ALLOC>& buffer, char32_t cp)
+	{
+		char bytes[4];
+		const auto length = detail::encode_utf8(cp, bytes);
+		buffer.append(bytes, length);
+		return length;
+	}
+
+	inline size_t append_utf8(std::string& buffer, char32_t cp) { return append_utf8<std::char_traits<char>, std::allocator<char>>(buffer, cp); }
+
+	/// ///////////////////////////// ///
+	/// String builder
+	/// ///////////////////////////// ///
+
+	/// An append-only output sink. The first `INLINE_CAPACITY` bytes live inside the object; after that, content goes into heap blocks,
+	/// each at least twice the size of the previous one, so appending never moves what was already written.
+	/// Blocks are kept on `clear()` and `truncate()`, so a reused builder stops allocating once it has grown to its working size.
+	/// Blocks come from `ALLOC` (rebound as needed), so e.g. a `std::pmr::polymorphic_allocator` keeps the builder inside an arena.
+	template <size_t INLINE_CAPACITY = 256, typename ALLOC = std::allocator<char>>
+	class basic_string_builder
 	{
-		if (cp < 0x80)
+		static_assert(INLINE_CAPACITY > 0);
+
+	public:
+
+		using allocator_type = ALLOC;
+
+		basic_string_builder() noexcept = default;
+		explicit basic_string_builder(ALLOC const& alloc) noexcept : m_allocator(alloc) {}
+		basic_string_builder(basic_string_builder const&) = delete;
+		basic_string_builder& operator=(basic_string_builder const&) = delete;
+		~basic_string_builder() { free_blocks(m_first_block); }
+
+		[[nodiscard]] size_t size() const noexcept { return m_size_before_current + size_t(m_cursor - m_current_begin); }
+		[[nodiscard]] bool empty() const noexcept { return size() == 0; }
+		/// Bytes that can be appended before the next allocation (or reuse of an older block)
+		[[nodiscard]] size_t available() const noexcept { return size_t(m_limit - m_cursor); }
+
+		basic_string_builder& append(string_view str)
 		{
-			buffer += static_cast<char>(cp);
-			return 1;
+			if (str.size() > available()) [[unlikely]]
+			{
+				const auto first_part = available();
+				std::memcpy(m_cursor, str.data(), first_part);
+				m_cursor += first_part;
+				str.remove_prefix(first_part);
+				next_block(str.size());
+			}
+			std::memcpy(m_cursor, str.data(), str.size());
+			m_cursor += str.size();
+			return *this;
 		}
-		else if (cp < 0x800)
+
+		basic_string_builder& append(char c)
 		{
-			buffer += static_cast<char>((cp >> 6) | 0xc0);
-			buffer += static_cast<char>((cp & 0x3f) | 0x80);
-			return 2;
+			if (m_cursor == m_limit) [[unlikely]]
+				next_block(1);
+			*m_cursor++ = c;
+			return *this;
 		}
-		else if (cp < 0x10000)
+
+		basic_string_builder& append(size_t count, char c)
 		{
-			buffer += static_cast<char>((cp >> 12) | 0xe0);
-			buffer += static_cast<char>(((cp >> 6) & 0x3f) | 0x80);
-			buffer += static_cast<char>((cp & 0x3f) | 0x80);
-			return 3;
+			while (count)
+			{
+				if (m_cursor == m_limit)
+					next_block(count);
+				const auto n = std::min(count, available());
+				std::memset(m_cursor, c, n);
+				m_cursor += n;
+				count -= n;
+			}
+			return *this;
 		}
-		else
+
+		void push_back(char c) { append(c); }
+
+		/// Assuming codepoint is valid
+		size_t append_utf8(char32_t cp)
 		{
-			buffer += static_cast<char>((cp >> 18) | 0xf0);
-			buffer += static_cast<char>(((cp >> 12) & 0x3f) | 0x80);
-			buffer += static_cast<char>(((cp >> 6) & 0x3f) | 0x80);
-			buffer += static_cast<char>((cp & 0x3f) | 0x80);
-			return 4;
+			ensure_contiguous(4);
+			const auto length = detail::encode_utf8(cp, m_cursor);
+			m_cursor += length;
+			return length;
 		}
-	}
 
-	/// ///////////////////////////// ///
-	/// Other
-	/// ///////////////////////////// ///
+		template <std::integral T>
+		basic_string_builder& append_integer(T value, int base = 10)
+		{
+			ensure_contiguous(std::numeric_limits<T>::digits + 2);
+			m_cursor = std::to_chars(m_cursor, m_limit, value, base).ptr;
+			return *this;
+		}
 
-	template <typename DELIM, typename FUNC>
-	inline void split(string_view source, DELIM&& delim, FUNC&& func) noexcept
-	{
-		size_t next = 0;
-		while ((next = source.find_first_of(delim)) != std::string::npos)
+		/// Shortest representation that round-trips
+		template <std::floating_point T>
+		basic_string_builder& append_float(T value)
 		{
-			func(source.substr(0, next), false);
-			source.remove_prefix(next + 1);
+			return append_float_with([value](char* first, char* last) { return std::to_chars(first, last, value); });
 		}
-		func(source, true);
-	}
 
-	template <typename DELIM, typename FUNC>
-	inline void natural_split(string_view source, DELIM&& delim, FUNC&& func) noexcept
-	{
-		size_t next = 0;
-		while ((next = source.find_first_of(delim)) != std::string::npos)
+		template <std::floating_point T>
+		basic_string_builder& append_float(T value, std::chars_format format)
 		{
-			func(source.substr(0, next), false);
-			source.remove_prefix(next + 1);
+			return append_float_with([=](char* first, char* last) { return std::to_chars(first, last, value, format); });
+		}
 
-			if ((next = source.find_first_not_of(delim)) == std::string::npos)
-				return;
+		template <std::floating_point T>
+		basic_string_builder& append_float(T value, std::chars_format format, int precision)
+		{
+			return append_float_with([=](char* first, char* last) { return std::to_chars(first, last, value, format, precision); });
+		}
 
-			source.remove_prefix(next);
+		/// Appends strings, characters, integers and floating point values
+		template <typename T>
+		basic_string_builder& operator<<(T const& value)
+		{
+			if constexpr (std::same_as<T, char>)
+				return append(value);
+			else if constexpr (std::is_convertible_v<T const&, string_view>)
+				return append(string_view{ value });
+			else if constexpr (std::same_as<T, bool>)
+				return append(value ? '1' : '0');
+			else if constexpr (std::integral<T>)
+				return append_integer(value);
+			else if constexpr (std::floating_point<T>)
+				return append_float(value);
+			else
+				static_assert(!sizeof(T), "type cannot be appended to a string builder");
 		}
 
-		if (!source.empty())
-			func(source, true);
-	}
+		/// Guarantees that the next `count` bytes are appended contiguously and without allocating, allocating at most a single block of exactly `count` bytes
+		void reserve_exact(size_t count)
+		{
+			if (available() < count)
+				next_block(count, true);
+		}
 
-	template <typename DELIM>
-	[[nodiscard]] inline std::vector<string_view> split(string_view source, DELIM&& delim) noexcept
-	{
-		std::vector<string_view> result;
-		::ghassanpl::string_ops::split(source, std::forward<DELIM>(delim), [&result](string_view str, bool last) {
-			result.push_back(str);
+		void clear() noexcept { truncate(0); }
+
+		/// Drops everything after the first `new_size` bytes
+		void truncate(size_t new_size) noexcept
+		{
+			if (new_size >= size())
+				return;
+
+			block_header* block = nullptr;
+			char* begin = m_inline;
+			size_t capacity = INLINE_CAPACITY;
+			size_t before = 0;
+			while (true)
+			{
+				const size_t used = block == m_current_block ? size_t(m_cursor - begin) : (block ? block->used : m_inline_used);
+				if (new_size - before <= used)
+					break;
+				before += used;
+				block = block ? block->next : m_first_block;
+				begin = block_data(block);
+				capacity = block->capacity;
+			}
+
+			m_current_block = block;
+			m_current_begin = begin;
+			m_cursor = begin + (new_size - before);
+			m_limit = begin + capacity;
+			m_size_before_current = before;
+		}
+
+		/// Calls `func(string_view)` for each non-empty contiguous piece of the content, in order
+		template <typename FUNC>
+		void for_each_chunk(FUNC&& func) const
+		{
+			if (m_current_block == nullptr)
+			{
+				if (m_cursor != m_inline) func(make_sv(m_inline, m_cursor));
+				return;
+			}
+
+			if (m_inline_used) func(string_view{ m_inline, m_inline_used });
+			for (auto block = m_first_block; block != m_current_block; block = block->next)
+				if (block->used) func(string_view{ block_data(block), block->used });
+			if (m_cursor != m_current_begin) func(make_sv(m_current_begin, m_cursor));
+		}
+
+		/// Copies `size()` bytes to `out`; returns the end of the written range
+		char* copy_to(char* out) const
+		{
+			for_each_chunk([&out](string_view chunk) { std::memcpy(out, chunk.data(), chunk.size()); out += chunk.size(); });
+			return out;
+		}
+
+		[[nodiscard]] std::string str() const
+		{
+			std::string result(size(), '\0');
+			copy_to(result.data());
+			return result;
+		}
+
+		template <detail::allocator STRING_ALLOC>
+		[[nodiscard]] detail::string_for<STRING_ALLOC> str(STRING_ALLOC const& alloc) const
+		{
+			detail::string_for<STRING_ALLOC> result(size(), '\0', alloc);
+			copy_to(result.data());
+			return result;
+		}
+
+		[[nodiscard]] allocator_type get_allocator() const noexcept { return allocator_type(m_allocator); }
+
+		/// The content as a single view; if it is spread across several blocks, they are first merged into a new one
+		[[nodiscard]] string_view view()
+		{
+			if (m_size_before_current != 0)
+			{
+				const auto total = size();
+				const auto merged = allocate_block(total * 2);
+				copy_to(block_data(merged));
+				free_blocks(m_first_block);
+				m_first_block = m_current_block = merged;
+				m_inline_used = 0;
+				m_size_before_current = 0;
+				m_current_begin = block_data(merged);
+				m_cursor = m_current_begin + total;
+				m_limit = m_current_begin + merged->capacity;
+			}
+			return make_sv(m_current_begin, m_cursor);
+		}
+
+	private:
+
+		struct block_header
+		{
+			block_header* next;
+			size_t capacity;
+			size_t used;
+		};
+
+		using block_allocator = detail::rebind_alloc<ALLOC, block_header>;
+
+		static char* block_data(block_header* block) noexcept { return reinterpret_cast<char*>(block + 1); }
+		/// Blocks are allocated as arrays of headers so that the allocator only ever sees one type
+		static size_t block_units(size_t capacity) noexcept { return 1 + (capacity + sizeof(block_header) - 1) / sizeof(block_header); }
+
+		block_header* allocate_block(size_t capacity)
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(string_builder_block, capacity);
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(1);
+			const auto units = block_units(capacity);
+			const auto block = std::allocator_traits<block_allocator>::allocate(m_allocator, units);
+			block->next = nullptr;
+			block->capacity = (units - 1) * sizeof(block_header);
+			block->used = 0;
+			return block;
+		}
+
+		void free_blocks(block_header* block) noexcept
+		{
+			while (block)
+			{
+				const auto next = block->next;
+				std::allocator_traits<block_allocator>::deallocate(m_allocator, block, block_units(block->capacity));
+				block = next;
+			}
+		}
+
+		void ensure_contiguous(size_t count)
+		{
+			if (available() < count) [[unlikely]]
+				next_block(count);
+		}
+
+		/// Closes the current block and makes the next one (reused or newly allocated) current
+		void next_block(size_t min_capacity, bool exact = false)
+		{
+			const auto used = size_t(m_cursor - m_current_begin);
+			if (m_current_block) m_current_block->used = used;
+			else m_inline_used = used;
+			m_size_before_current += used;
+
+			const size_t current_capacity = size_t(m_limit - m_current_begin);
+			const size_t capacity = exact ? min_capacity : std::max(min_capacity, current_capacity * 2);
+
+			auto& link = m_current_block ? m_current_block->next : m_first_block;
+			if (!link || link->capacity < capacity)
+			{
+				free_blocks(link);
+				link = allocate_block(capacity);
+			}
+
+			m_current_block = link;
+			m_current_begin = m_cursor = block_data(link);
+			m_limit = m_current_begin + link->capacity;
+		}
+
+		template <typename TO_CHARS>
+		basic_string_builder& append_float_with(TO_CHARS&& to_chars)
+		{
+			for (size_t needed = 32;; needed *= 2)
+			{
+				ensure_contiguous(needed);
+				const auto result = to_chars(m_cursor, m_limit);
+				if (result.ec == std::errc{})
+				{
+					m_cursor = result.ptr;
+					return *this;
+				}
+			}
+		}
+
+		char m_inline[INLINE_CAPACITY];
+		[[no_unique_address]] block_allocator m_allocator{};
+		size_t m_inline_used = 0;
+		block_header* m_first_block = nullptr;
+		block_header* m_current_block = nullptr; /// nullptr if we're still writing to `m_inline`
+		char* m_current_begin = m_inline;
+		char* m_cursor = m_inline;
+		char* m_limit = m_inline + INLINE_CAPACITY;
+		size_t m_size_before_current = 0;
+	};
+
+	using string_builder = basic_string_builder<>;
+
+	template <size_t N, typename A>
+	inline size_t append_utf8(basic_string_builder<N, A>& buffer, char32_t cp)
+	{
+		return buffer.append_utf8(cp);
+	}
+
+	/// Appends the decoded contents of the literal to `out` (nothing on failure) and returns the literal itself, or an empty view if it is malformed
+	template <size_t N, typename A>
+	inline string_view consume_c_string(string_view& strv, basic_string_builder<N, A>& out)
+	{
+		const auto previous_size = out.size();
+		const auto literal = detail::consume_c_string_into(strv, out);
+		if (literal.empty())
+			out.truncate(previous_size);
+		return literal;
+	}
+
+	/// ///////////////////////////// ///
+	/// Hex and Base64
+	/// ///////////////////////////// ///
+
+	/// Result of the bulk decoding functions. `out` points one past the last byte written, `error_at` is the index of the
+	/// first input character that could not be decoded (or `string_view::npos` if the whole input was valid)
+	struct decode_result
+	{
+		char* out = nullptr;
+		size_t error_at = string_view::npos;
+
+		[[nodiscard]] explicit operator bool() const noexcept { return error_at == string_view::npos; }
+	};
+
+	enum class base64_alphabet
+	{
+		standard, /// RFC 4648 section 4, `+` and `/`
+		url_safe, /// RFC 4648 section 5, `-` and `_`
+	};
+
+	namespace detail
+	{
+		inline constexpr char hex_digits_upper[] = "0123456789ABCDEF";
+
+		struct hex_pair_table { char pairs[256][2]; };
+		inline constexpr hex_pair_table hex_pairs = [] {
+			hex_pair_table result{};
+			for (int i = 0; i < 256; ++i)
+			{
+				result.pairs[i][0] = (char)::ghassanpl::string_ops::ascii::toxdigit(i >> 4);
+				result.pairs[i][1] = (char)::ghassanpl::string_ops::ascii::toxdigit(i & 15);
+			}
+			return result;
+		}();
+
+		struct nibble_table { uint8_t values[256]; };
+		inline constexpr nibble_table hex_values = [] {
+			nibble_table result{};
+			for (int i = 0; i < 256; ++i)
+			{
+				if (::ghassanpl::string_ops::ascii::isdigit(i)) result.values[i] = uint8_t(i - '0');
+				else if (::ghassanpl::string_ops::ascii::isxdigit(i)) result.values[i] = uint8_t((::ghassanpl::string_ops::ascii::toupper(char32_t(i)) - 'A') + 10);
+				else result.values[i] = 0xFF;
+			}
+			return result;
+		}();
+
+		inline constexpr char base64_chars[2][65] = {
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_",
+		};
+
+		struct base64_table { uint8_t values[2][256]; };
+		inline constexpr base64_table base64_values = [] {
+			base64_table result{};
+			for (int a = 0; a < 2; ++a)
+			{
+				for (auto& v : result.values[a]) v = 0xFF;
+				for (int i = 0; i < 64; ++i)
+					result.values[a][(uint8_t)base64_chars[a][i]] = uint8_t(i);
+			}
+			return result;
+		}();
+
+		/// Index of the first character of `str` that is not a hex digit
+		[[nodiscard]] inline size_t first_non_hex(string_view str) noexcept
+		{
+			return size_t(std::find_if_not(str.begin(), str.end(), [](char c) { return ::ghassanpl::string_ops::ascii::isxdigit(c); }) - str.begin());
+		}
+	}
+
+	[[nodiscard]] inline constexpr size_t hex_encoded_size(size_t byte_count) noexcept { return byte_count * 2; }
+	[[nodiscard]] inline constexpr size_t hex_decoded_size(size_t char_count) noexcept { return char_count / 2; }
+
+	/// Writes exactly `hex_encoded_size(bytes.size())` uppercase hex digits (as produced by `ascii::toxdigit`) to `out`;
+	/// returns the end of the written range
+	inline char* hex_encode(string_view bytes, char* out) noexcept
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(hex_encode, bytes.size());
+		auto in = (const uint8_t*)bytes.data();
+		auto const end = in + bytes.size();
+
+#if GHASSANPL_STRING_OPS_SSSE3
+		const __m128i lut = _mm_loadu_si128((const __m128i*)detail::hex_digits_upper);
+		const __m128i low_mask = _mm_set1_epi8(0x0F);
+		for (; end - in >= 16; in += 16, out += 32)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)in);
+			const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low_mask));
+			const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, low_mask));
+			_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+			_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+		}
+#endif
+
+		for (; in != end; ++in, out += 2)
+			std::memcpy(out, detail::hex_pairs.pairs[*in], 2);
+		return out;
+	}
+
+	[[nodiscard]] inline std::string hex_encode(string_view bytes)
+	{
+		std::string result(hex_encoded_size(bytes.size()), '\0');
+		hex_encode(bytes, result.data());
+		return result;
+	}
+
+	/// Accepts both upper- and lowercase digits. Writes `hex_decoded_size(hex.size())` bytes to `out` on success.
+	/// An odd-length input reports `error_at == hex.size()`.
+	inline decode_result hex_decode(string_view hex, char* out) noexcept
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(hex_decode, hex.size());
+		auto in = (const uint8_t*)hex.data();
+		auto const begin = in;
+		auto const end = in + (hex.size() & ~size_t(1));
+
+#if GHASSANPL_STRING_OPS_SSSE3
+		const __m128i zero_char = _mm_set1_epi8('0');
+		const __m128i a_char = _mm_set1_epi8('a');
+		const __m128i case_bit = _mm_set1_epi8(0x20);
+		const __m128i nine = _mm_set1_epi8(9);
+		const __m128i five = _mm_set1_epi8(5);
+		const __m128i ten = _mm_set1_epi8(10);
+		const __m128i nibble_weights = _mm_set1_epi16(0x0110);
+		for (; end - in >= 16; in += 16, out += 8)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)in);
+			const __m128i digit = _mm_sub_epi8(v, zero_char);
+			const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+			const __m128i letter = _mm_sub_epi8(_mm_or_si128(v, case_bit), a_char);
+			const __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, five), letter);
+			if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xFFFF)
+				break; /// let the scalar loop find the exact position
+			const __m128i nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit), _mm_and_si128(is_letter, _mm_add_epi8(letter, ten)));
+			const __m128i bytes = _mm_maddubs_epi16(nibbles, nibble_weights);
+			_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(bytes, bytes));
+		}
+#endif
+
+		for (; in != end; in += 2)
+		{
+			const auto hi = detail::hex_values.values[in[0]];
+			const auto lo = detail::hex_values.values[in[1]];
+			if ((hi | lo) & 0xF0)
+				return { out, size_t(in - begin) + (hi & 0xF0 ? 0 : 1) };
+			*out++ = char((hi << 4) | lo);
+		}
+
+		if (hex.size() & 1)
+		{
+			if (!ascii::isxdigit(hex.back()))
+				return { out, hex.size() - 1 };
+			return { out, hex.size() };
+		}
+		return { out };
+	}
+
+	[[nodiscard]] inline constexpr size_t base64_encoded_size(size_t byte_count, bool pad = true) noexcept
+	{
+		return pad ? ((byte_count + 2) / 3) * 4 : (byte_count / 3) * 4 + (byte_count % 3 ? byte_count % 3 + 1 : 0);
+	}
+
+	/// Exact number of bytes `base64_decode` will write for a valid `encoded` string (padded or not)
+	[[nodiscard]] inline constexpr size_t base64_decoded_size(string_view encoded) noexcept
+	{
+		auto size = encoded.size();
+		if (size && encoded[size - 1] == '=') --size;
+		if (size && encoded[size - 1] == '=') --size;
+		return (size / 4) * 3 + (size % 4 ? size % 4 - 1 : 0);
+	}
+
+	/// Writes exactly `base64_encoded_size(bytes.size(), pad)` characters to `out`; returns the end of the written range
+	inline char* base64_encode(string_view bytes, char* out, base64_alphabet alphabet = base64_alphabet::standard, bool pad = true) noexcept
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(base64_encode, bytes.size());
+		auto in = (const uint8_t*)bytes.data();
+		auto const end = in + bytes.size();
+		const char* const chars = detail::base64_chars[int(alphabet)];
+
+#if GHASSANPL_STRING_OPS_SSSE3
+		/// 12 input bytes per iteration, but we load 16 so we need at least that many left
+		const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+		const __m128i offsets = alphabet == base64_alphabet::standard
+			? _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0)
+			: _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+		for (; end - in >= 16; in += 12, out += 16)
+		{
+			const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), spread);
+			const __m128i ac = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+			const __m128i bd = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+			const __m128i indices = _mm_or_si128(ac, bd);
+			__m128i offset_index = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+			offset_index = _mm_or_si128(offset_index, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+			_mm_storeu_si128((__m128i*)out, _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, offset_index)));
+		}
+#endif
+
+		for (; end - in >= 3; in += 3, out += 4)
+		{
+			const uint32_t triple = (uint32_t(in[0]) << 16) | (uint32_t(in[1]) << 8) | in[2];
+			out[0] = chars[(triple >> 18) & 63];
+			out[1] = chars[(triple >> 12) & 63];
+			out[2] = chars[(triple >> 6) & 63];
+			out[3] = chars[triple & 63];
+		}
+
+		if (const auto rest = end - in)
+		{
+			const uint32_t triple = (uint32_t(in[0]) << 16) | (rest > 1 ? uint32_t(in[1]) << 8 : 0);
+			*out++ = chars[(triple >> 18) & 63];
+			*out++ = chars[(triple >> 12) & 63];
+			if (rest > 1) *out++ = chars[(triple >> 6) & 63];
+			else if (pad) *out++ = '=';
+			if (pad) *out++ = '=';
+		}
+		return out;
+	}
+
+	[[nodiscard]] inline std::string base64_encode(string_view bytes, base64_alphabet alphabet = base64_alphabet::standard, bool pad = true)
+	{
+		std::string result(base64_encoded_size(bytes.size(), pad), '\0');
+		base64_encode(bytes, result.data(), alphabet, pad);
+		return result;
+	}
+
+	/// Accepts padded and unpadded input. Writes `base64_decoded_size(encoded)` bytes to `out` on success.
+	/// Padding is only valid at the very end and only if it brings the length up to a multiple of 4.
+	inline decode_result base64_decode(string_view encoded, char* out, base64_alphabet alphabet = base64_alphabet::standard) noexcept
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(base64_decode, encoded.size());
+		auto size = encoded.size();
+		if (size && encoded[size - 1] == '=') --size;
+		if (size && encoded[size - 1] == '=') --size;
+		if (size != encoded.size() && encoded.size() % 4 != 0)
+			return { out, size };
+
+		auto in = (const uint8_t*)encoded.data();
+		auto const begin = in;
+		auto const end = in + size;
+		const uint8_t* const values = detail::base64_values.values[int(alphabet)];
+
+#if GHASSANPL_STRING_OPS_SSSE3
+		if (alphabet == base64_alphabet::standard)
+		{
+			const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+			const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+			const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+			const __m128i nibble_mask = _mm_set1_epi8(0x2F);
+			const __m128i gather = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+			for (; end - in >= 16; in += 16, out += 12)
+			{
+				const __m128i v = _mm_loadu_si128((const __m128i*)in);
+				const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), nibble_mask);
+				const __m128i lo_nibbles = _mm_and_si128(v, nibble_mask);
+				const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xFFFF)
+					break; /// let the scalar loop find the exact position
+				const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, nibble_mask), hi_nibbles));
+				const __m128i sextets = _mm_add_epi8(v, roll);
+				const __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+				const __m128i triples = _mm_shuffle_epi8(_mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000)), gather);
+				_mm_storel_epi64((__m128i*)out, triples);
+				const auto last = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(triples, 8)));
+				std::memcpy(out + 8, &last, 4);
+			}
+		}
+#endif
+
+		const auto bad_position = [&](const uint8_t* at) { return size_t(std::find_if(at, end, [values](uint8_t c) { return values[c] == 0xFF; }) - begin); };
+
+		for (; end - in >= 4; in += 4, out += 3)
+		{
+			const auto a = values[in[0]], b = values[in[1]], c = values[in[2]], d = values[in[3]];
+			if ((a | b | c | d) & 0x80)
+				return { out, bad_position(in) };
+			const uint32_t triple = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | d;
+			out[0] = char(triple >> 16);
+			out[1] = char(triple >> 8);
+			out[2] = char(triple);
+		}
+
+		switch (end - in)
+		{
+		case 1:
+			if (values[in[0]] == 0xFF)
+				return { out, bad_position(in) };
+			return { out, size };
+		case 2:
+		case 3:
+		{
+			const auto rest = end - in;
+			const auto a = values[in[0]], b = values[in[1]], c = rest > 2 ? values[in[2]] : uint8_t(0);
+			if ((a | b | c) & 0x80)
+				return { out, bad_position(in) };
+			const uint32_t triple = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6);
+			*out++ = char(triple >> 16);
+			if (rest > 2) *out++ = char(triple >> 8);
+			break;
+		}
+		}
+		return { out };
+	}
+
+	/// ///////////////////////////// ///
+	/// Other
+	/// ///////////////////////////// ///
+
+	template <typename DELIM, typename FUNC>
+	requires std::invocable<FUNC&, string_view, bool>
+	inline void split(string_view source, DELIM&& delim, FUNC&& func) noexcept
+	{
+		size_t next = 0;
+		while ((next = source.find_first_of(delim)) != std::string::npos)
+		{
+			func(source.substr(0, next), false);
+			source.remove_prefix(next + 1);
+		}
+		func(source, true);
+	}
+
+	template <typename DELIM, typename FUNC>
+	requires std::invocable<FUNC&, string_view, bool>
+	inline void natural_split(string_view source, DELIM&& delim, FUNC&& func) noexcept
+	{
+		size_t next = 0;
+		while ((next = source.find_first_of(delim)) != std::string::npos)
+		{
+			func(source.substr(0, next), false);
+			source.remove_prefix(next + 1);
+
+			if ((next = source.find_first_not_of(delim)) == std::string::npos)
+				return;
+
+			source.remove_prefix(next);
+		}
+
+		if (!source.empty())
+			func(source, true);
+	}
+
+	/// Append to a caller-owned vector, reusing its capacity
+	template <typename DELIM, typename ALLOC>
+	inline void split(string_view source, DELIM&& delim, std::vector<string_view, ALLOC>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(split, source.size());
+		::ghassanpl::string_ops::split(source, std::forward<DELIM>(delim), [&](string_view str, bool) {
+			if (out.size() == out.capacity())
+				GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(1);
+			out.push_back(str);
+		});
+	}
+
+	template <typename DELIM, typename ALLOC>
+	inline void natural_split(string_view source, DELIM&& delim, std::vector<string_view, ALLOC>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(natural_split, source.size());
+		::ghassanpl::string_ops::natural_split(source, std::forward<DELIM>(delim), [&](string_view str, bool) {
+			if (out.size() == out.capacity())
+				GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(1);
+			out.push_back(str);
 		});
+	}
+
+	template <typename DELIM>
+	[[nodiscard]] inline std::vector<string_view> split(string_view source, DELIM&& delim) noexcept
+	{
+		std::vector<string_view> result;
+		::ghassanpl::string_ops::split(source, std::forward<DELIM>(delim), result);
 		return result;
 	}
 
@@ -443,15 +1655,30 @@ namespace ghassanpl::string_ops
 	[[nodiscard]] inline std::vector<string_view> natural_split(string_view source, DELIM&& delim) noexcept
 	{
 		std::vector<string_view> result;
-		::ghassanpl::string_ops::natural_split(source, std::forward<DELIM>(delim), [&result](string_view str, bool last) {
-			result.push_back(str);
-		});
+		::ghassanpl::string_ops::natural_split(source, std::forward<DELIM>(delim), result);
+		return result;
+	}
+
+	template <typename DELIM, detail::allocator ALLOC>
+	[[nodiscard]] inline std::vector<string_view, detail::rebind_alloc<ALLOC, string_view>> split(string_view source, DELIM&& delim, ALLOC const& alloc)
+	{
+		std::vector<string_view, detail::rebind_alloc<ALLOC, string_view>> result(alloc);
+		::ghassanpl::string_ops::split(source, std::forward<DELIM>(delim), result);
+		return result;
+	}
+
+	template <typename DELIM, detail::allocator ALLOC>
+	[[nodiscard]] inline std::vector<string_view, detail::rebind_alloc<ALLOC, string_view>> natural_split(string_view source, DELIM&& delim, ALLOC const& alloc)
+	{
+		std::vector<string_view, detail::rebind_alloc<ALLOC, string_view>> result(alloc);
+		::ghassanpl::string_ops::natural_split(source, std::forward<DELIM>(delim), result);
 		return result;
 	}
 
 	template <std::ranges::range T, typename DELIM>
 	[[nodiscard]] inline auto join(T&& source, DELIM&& delim)
 	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(join, 0);
 		std::stringstream strm;
 		bool first = true;
 		for (auto&& p : std::forward<T>(source))
@@ -460,7 +1687,11 @@ namespace ghassanpl::string_ops
 			strm << p;
 			first = false;
 		}
-		return strm.str();
+		GHASSANPL_STRING_OPS_STATS_BYTES(std::streamoff(strm.tellp()));
+		auto result = strm.str();
+		/// The stream's own buffer needed a heap block too whenever the copy it hands back does
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(2 * detail::heap_allocated(result));
+		return result;
 	}
 
 	template <std::ranges::range T, typename DELIM, typename LAST_DELIM>
@@ -470,6 +1701,7 @@ namespace ghassanpl::string_ops
 		using std::end;
 		using std::next;
 
+		GHASSANPL_STRING_OPS_STATS_SCOPE(join_and, 0);
 		std::stringstream strm;
 		bool first = true;
 		
@@ -486,12 +1718,17 @@ namespace ghassanpl::string_ops
 			strm << *it;
 			first = false;
 		}
-		return strm.str();
+		GHASSANPL_STRING_OPS_STATS_BYTES(std::streamoff(strm.tellp()));
+		auto result = strm.str();
+		/// The stream's own buffer needed a heap block too whenever the copy it hands back does
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(2 * detail::heap_allocated(result));
+		return result;
 	}
 
 	template <std::ranges::range T, typename FUNC, typename DELIM>
 	[[nodiscard]] inline auto join(T&& source, DELIM&& delim, FUNC&& transform_func)
 	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(join, 0);
 		std::stringstream strm;
 		bool first = true;
 		for (auto&& p : source)
@@ -500,33 +1737,2675 @@ namespace ghassanpl::string_ops
 			strm << transform_func(p);
 			first = false;
 		}
-		return strm.str();
+		GHASSANPL_STRING_OPS_STATS_BYTES(std::streamoff(strm.tellp()));
+		auto result = strm.str();
+		/// The stream's own buffer needed a heap block too whenever the copy it hands back does
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(2 * detail::heap_allocated(result));
+		return result;
 	}
 
-	template <typename NEEDLE, typename REPLACE>
-	inline void replace(std::string& subject, NEEDLE&& search, REPLACE&& replace)
+	namespace detail
 	{
-		using std::empty;
-		using std::size;
+		template <typename TRAITS, typename ALLOC, typename T>
+		void append_value(std::basic_string<char, TRAITS, ALLOC>& out, T const& value)
+		{
+			if constexpr (std::same_as<T, char>)
+				out += value;
+			else if constexpr (std::is_convertible_v<T const&, string_view>)
+				out += string_view{ value };
+			else if constexpr (std::same_as<T, bool>)
+				out += value ? '1' : '0';
+			else if constexpr (std::integral<T> || std::floating_point<T>)
+			{
+				char buffer[64];
+				out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+			}
+			else
+				static_assert(!sizeof(T), "type cannot be appended to a string");
+		}
 
-		if (std::string_view{ search }.empty())
-			return;
+		template <size_t N, typename A, typename T>
+		void append_value(basic_string_builder<N, A>& out, T const& value) { out << value; }
 
-		const auto search_size = std::string_view{ search }.size();
-		const auto replace_size = std::string_view{ replace }.size();
+		/// Builders count their own blocks, so only a string output is checked for having grown
+		template <typename OUTPUT>
+		[[nodiscard]] size_t output_capacity(OUTPUT const& out) noexcept
+		{
+			if constexpr (requires { out.capacity(); })
+				return out.capacity();
+			else
+				return 0;
+		}
 
-		size_t pos = 0;
-		while ((pos = subject.find(search, pos)) != std::string::npos)
+		template <typename OUTPUT, typename T, typename DELIM, typename FUNC>
+		void join_into(OUTPUT& out, T&& source, DELIM const& delim, FUNC&& transform_func)
 		{
-			subject.replace(pos, search_size, replace);
-			pos += replace_size;
+			GHASSANPL_STRING_OPS_STATS_SCOPE(join, 0);
+			[[maybe_unused]] const auto start_size = out.size();
+			[[maybe_unused]] const auto start_capacity = output_capacity(out);
+			bool first = true;
+			for (auto&& p : source)
+			{
+				if (!first) append_value(out, delim);
+				append_value(out, transform_func(p));
+				first = false;
+			}
+			GHASSANPL_STRING_OPS_STATS_BYTES(out.size() - start_size);
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(output_capacity(out) != start_capacity);
+		}
+
+		template <typename OUTPUT, typename T, typename DELIM, typename LAST_DELIM>
+		void join_and_into(OUTPUT& out, T&& source, DELIM const& delim, LAST_DELIM const& last_delim)
+		{
+			using std::begin;
+			using std::end;
+			using std::next;
+
+			GHASSANPL_STRING_OPS_STATS_SCOPE(join_and, 0);
+			[[maybe_unused]] const auto start_size = out.size();
+			[[maybe_unused]] const auto start_capacity = output_capacity(out);
+			bool first = true;
+
+			auto&& endit = end(source);
+			for (auto it = begin(source); it != endit; ++it)
+			{
+				if (!first)
+				{
+					if (next(it) == endit)
+						append_value(out, last_delim);
+					else
+						append_value(out, delim);
+				}
+				append_value(out, *it);
+				first = false;
+			}
+			GHASSANPL_STRING_OPS_STATS_BYTES(out.size() - start_size);
+			GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(output_capacity(out) != start_capacity);
 		}
 	}
 
+	/// Versions of `join` and `join_and` that append to a string builder or a caller-owned string instead of going through a stringstream
 
-	template <typename T>
-	inline auto from_chars(std::string_view str, T& value, const int base = 10) noexcept {
-		return std::from_chars(str.data(), str.data() + str.size(), value, base);
+	template <std::ranges::range T, typename DELIM, size_t N, typename A>
+	inline basic_string_builder<N, A>& join(T&& source, DELIM&& delim, basic_string_builder<N, A>& out)
+	{
+		detail::join_into(out, std::forward<T>(source), delim, std::identity{});
+		return out;
 	}
 
-}
\ No newline at end of file
+	template <std::ranges::range T, typename DELIM, typename LAST_DELIM, size_t N, typename A>
+	inline basic_string_builder<N, A>& join_and(T&& source, DELIM&& delim, LAST_DELIM&& last_delim, basic_string_builder<N, A>& out)
+	{
+		detail::join_and_into(out, std::forward<T>(source), delim, last_delim);
+		return out;
+	}
+
+	template <std::ranges::range T, typename FUNC, typename DELIM, size_t N, typename A>
+	inline basic_string_builder<N, A>& join(T&& source, DELIM&& delim, FUNC&& transform_func, basic_string_builder<N, A>& out)
+	{
+		detail::join_into(out, std::forward<T>(source), delim, std::forward<FUNC>(transform_func));
+		return out;
+	}
+
+	template <std::ranges::range T, typename DELIM, typename TRAITS, typename ALLOC>
+	inline std::basic_string<char, TRAITS, ALLOC>& join(T&& source, DELIM&& delim, std::basic_string<char, TRAITS, ALLOC>& out)
+	{
+		detail::join_into(out, std::forward<T>(source), delim, std::identity{});
+		return out;
+	}
+
+	template <std::ranges::range T, typename DELIM, typename LAST_DELIM, typename TRAITS, typename ALLOC>
+	inline std::basic_string<char, TRAITS, ALLOC>& join_and(T&& source, DELIM&& delim, LAST_DELIM&& last_delim, std::basic_string<char, TRAITS, ALLOC>& out)
+	{
+		detail::join_and_into(out, std::forward<T>(source), delim, last_delim);
+		return out;
+	}
+
+	template <std::ranges::range T, typename FUNC, typename DELIM, typename TRAITS, typename ALLOC>
+	inline std::basic_string<char, TRAITS, ALLOC>& join(T&& source, DELIM&& delim, FUNC&& transform_func, std::basic_string<char, TRAITS, ALLOC>& out)
+	{
+		detail::join_into(out, std::forward<T>(source), delim, std::forward<FUNC>(transform_func));
+		return out;
+	}
+
+	template <typename NEEDLE, typename REPLACE>
+	inline void replace(std::string& subject, NEEDLE&& search, REPLACE&& replace)
+	{
+		using std::empty;
+		using std::size;
+
+		if (std::string_view{ search }.empty())
+			return;
+
+		const auto search_size = std::string_view{ search }.size();
+		const auto replace_size = std::string_view{ replace }.size();
+
+		size_t pos = 0;
+		while ((pos = subject.find(search, pos)) != std::string::npos)
+		{
+			subject.replace(pos, search_size, replace);
+			pos += replace_size;
+		}
+	}
+
+
+	template <typename T>
+	inline auto from_chars(std::string_view str, T& value, const int base = 10) noexcept {
+		return std::from_chars(str.data(), str.data() + str.size(), value, base);
+	}
+
+	/// ///////////////////////////// ///
+	/// Collation
+	/// ///////////////////////////// ///
+
+	enum class collation
+	{
+		binary,
+		ignore_case,         /// ASCII letters compare as if uppercased, like in `ascii::strings_equal_ignore_case`
+		natural,             /// Runs of ASCII digits compare by numeric value, so "file2" < "file10"
+		natural_ignore_case,
+	};
+
+	namespace detail
+	{
+		/// Runs `func(begin, end)` over `count` items split into contiguous chunks, one per hardware thread, but only
+		/// if each chunk gets at least `min_chunk` items; otherwise everything runs on the calling thread
+		template <typename FUNC>
+		void parallel_for_chunks(size_t count, size_t min_chunk, FUNC&& func)
+		{
+			const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count / std::max<size_t>(min_chunk, 1));
+			if (threads <= 1)
+			{
+				func(size_t{ 0 }, count);
+				return;
+			}
+
+			const size_t chunk = (count + threads - 1) / threads;
+			std::vector<std::thread> workers;
+			workers.reserve(threads - 1);
+			for (size_t begin = chunk; begin < count; begin += chunk)
+				workers.emplace_back([&func, begin, end = std::min(count, begin + chunk)] { func(begin, end); });
+			func(size_t{ 0 }, chunk);
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		/// Digit runs become '0', the number of significant digits (one byte, or 0xFF and four big-endian bytes), and the significant digits,
+		/// so that numbers with more digits sort later and leading zeros are ignored
+		template <bool WRITE>
+		size_t sort_key_impl(string_view str, collation coll, char* out) noexcept
+		{
+			const bool fold = coll == collation::ignore_case || coll == collation::natural_ignore_case;
+			const bool natural = coll == collation::natural || coll == collation::natural_ignore_case;
+
+			size_t size = 0;
+			const auto put = [&](char c) {
+				if constexpr (WRITE) out[size] = c;
+				++size;
+			};
+
+			for (size_t i = 0; i < str.size();)
+			{
+				if (natural && ascii::isdigit(str[i]))
+				{
+					while (i < str.size() && str[i] == '0') ++i;
+					const auto significant_start = i;
+					while (i < str.size() && ascii::isdigit(str[i])) ++i;
+					const auto digits = str.substr(significant_start, i - significant_start);
+
+					put('0');
+					if (digits.size() < 0xFF)
+						put(char(digits.size()));
+					else
+					{
+						put(char(0xFF));
+						for (int shift = 24; shift >= 0; shift -= 8)
+							put(char(uint32_t(digits.size()) >> shift));
+					}
+					if constexpr (WRITE) std::memcpy(out + size, digits.data(), digits.size());
+					size += digits.size();
+				}
+				else
+				{
+					put(fold ? (char)ascii::toupper(str[i]) : str[i]);
+					++i;
+				}
+			}
+			return size;
+		}
+	}
+
+	/// Sort keys turn `str` into a byte string such that comparing two keys as `string_view`s (i.e. with `memcmp`)
+	/// gives the order of the original strings under `coll`. Strings that differ only in leading zeros of numbers
+	/// or (when ignoring case) in case get equal keys.
+	[[nodiscard]] inline size_t sort_key_size(string_view str, collation coll) noexcept
+	{
+		return coll == collation::binary ? str.size() : detail::sort_key_impl<false>(str, coll, nullptr);
+	}
+
+	/// Writes exactly `sort_key_size(str, coll)` bytes to `out`; returns the end of the written range
+	inline char* make_sort_key(string_view str, collation coll, char* out) noexcept
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(make_sort_key, str.size());
+		return out + detail::sort_key_impl<true>(str, coll, out);
+	}
+
+	[[nodiscard]] inline std::string make_sort_key(string_view str, collation coll)
+	{
+		std::string result(sort_key_size(str, coll), '\0');
+		make_sort_key(str, coll, result.data());
+		return result;
+	}
+
+	template <detail::allocator ALLOC>
+	[[nodiscard]] inline detail::string_for<ALLOC> make_sort_key(string_view str, collation coll, ALLOC const& alloc)
+	{
+		detail::string_for<ALLOC> result(sort_key_size(str, coll), '\0', alloc);
+		make_sort_key(str, coll, result.data());
+		return result;
+	}
+
+	/// Sorts `items` by the collation order of `projection(item)` (which must be convertible to `string_view`).
+	/// Every key is generated exactly once, in parallel for large inputs, into a single buffer; equal keys keep their relative order.
+	template <typename T, typename PROJECTION = std::identity>
+	void sort_by_key(std::span<T> items, collation coll, PROJECTION&& projection = {})
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(sort_by_key, 0);
+		struct entry
+		{
+			uint64_t prefix; /// first 8 bytes of the key, big-endian, so most comparisons never touch the key buffer
+			const char* key;
+			size_t size;
+			size_t index;
+		};
+
+		static constexpr size_t min_items_per_thread = 16384;
+
+		const auto count = items.size();
+		if (count < 2)
+			return;
+
+		std::vector<entry> entries(count);
+		detail::parallel_for_chunks(count, min_items_per_thread, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				entries[i].size = sort_key_size(string_view{ projection(items[i]) }, coll);
+		});
+
+		size_t total = 0;
+		for (auto& e : entries)
+		{
+			e.index = total;
+			total += e.size;
+		}
+
+		const auto keys = std::make_unique_for_overwrite<char[]>(total);
+		detail::parallel_for_chunks(count, min_items_per_thread, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				auto& e = entries[i];
+				e.key = keys.get() + e.index;
+				make_sort_key(string_view{ projection(items[i]) }, coll, keys.get() + e.index);
+				e.prefix = 0;
+				for (size_t b = 0; b < 8; ++b)
+					e.prefix = (e.prefix << 8) | (b < e.size ? uint8_t(e.key[b]) : 0);
+				e.index = i;
+			}
+		});
+
+		std::sort(entries.begin(), entries.end(), [](entry const& a, entry const& b) {
+			if (a.prefix != b.prefix)
+				return a.prefix < b.prefix;
+			if (const auto order = string_view{ a.key, a.size }.compare(string_view{ b.key, b.size }))
+				return order < 0;
+			return a.index < b.index;
+		});
+
+		std::vector<T> sorted;
+		sorted.reserve(count);
+		for (auto& e : entries)
+			sorted.push_back(std::move(items[e.index]));
+		std::move(sorted.begin(), sorted.end(), items.begin());
+	}
+
+	/// ///////////////////////////// ///
+	/// String sorting
+	/// ///////////////////////////// ///
+
+	namespace detail
+	{
+		/// Up to 8 bytes of `str` starting at `depth`, big-endian and zero-padded, so integer order is byte order
+		inline uint64_t load_prefix(string_view str, size_t depth) noexcept
+		{
+			uint64_t result = 0;
+			const auto rest = str.size() > depth ? str.size() - depth : 0;
+			const auto bytes = (const uint8_t*)str.data() + depth;
+			const size_t n = std::min<size_t>(rest, 8);
+			for (size_t i = 0; i < n; ++i)
+				result |= uint64_t(bytes[i]) << (56 - 8 * i);
+			return result;
+		}
+
+		/// Multikey quicksort (Bentley & Sedgewick) using 8-byte "characters" cached next to each string
+		struct string_sort_entry
+		{
+			uint64_t prefix;
+			size_t rest; /// bytes left at the current depth, clamped to 9 (so 9 means "more than the prefix")
+			string_view str;
+
+			void load(size_t depth) noexcept
+			{
+				prefix = load_prefix(str, depth);
+				rest = str.size() > depth ? std::min<size_t>(str.size() - depth, 9) : 0;
+			}
+
+			/// Equal keys with `rest < 9` mean the strings are equal; shorter zero-padded prefixes sort first
+			[[nodiscard]] int compare_key(string_sort_entry const& other) const noexcept
+			{
+				if (prefix != other.prefix) return prefix < other.prefix ? -1 : 1;
+				if (rest != other.rest) return rest < other.rest ? -1 : 1;
+				return 0;
+			}
+		};
+
+		inline void insertion_sort_strings(string_sort_entry* first, string_sort_entry* last, size_t depth) noexcept
+		{
+			const auto less = [depth](string_sort_entry const& a, string_sort_entry const& b) {
+				if (const auto order = a.compare_key(b))
+					return order < 0;
+				return a.rest > 8 && a.str.substr(depth + 8) < b.str.substr(depth + 8);
+			};
+
+			for (auto it = first + 1; it < last; ++it)
+			{
+				auto value = *it;
+				auto hole = it;
+				for (; hole != first && less(value, hole[-1]); --hole)
+					*hole = hole[-1];
+				*hole = value;
+			}
+		}
+
+		/// Expects the entries in [first, last) to be loaded for `depth`
+		inline void multikey_quicksort(string_sort_entry* first, string_sort_entry* last, size_t depth) noexcept
+		{
+			while (last - first > 16)
+			{
+				auto a = first, b = first + (last - first) / 2, c = last - 1;
+				if (b->compare_key(*a) < 0) std::swap(a, b);
+				if (c->compare_key(*b) < 0) std::swap(b, c);
+				if (b->compare_key(*a) < 0) std::swap(a, b);
+				const auto pivot = *b;
+
+				auto lt = first, i = first, gt = last;
+				while (i < gt)
+				{
+					const auto order = i->compare_key(pivot);
+					if (order < 0) std::swap(*lt++, *i++);
+					else if (order > 0) std::swap(*i, *--gt);
+					else ++i;
+				}
+
+				if (pivot.rest > 8 && gt - lt > 1)
+				{
+					for (auto it = lt; it != gt; ++it)
+						it->load(depth + 8);
+					multikey_quicksort(lt, gt, depth + 8);
+				}
+
+				/// Recurse into the smaller side, loop on the larger to bound stack depth
+				if (lt - first < last - gt)
+				{
+					multikey_quicksort(first, lt, depth);
+					first = gt;
+				}
+				else
+				{
+					multikey_quicksort(gt, last, depth);
+					last = lt;
+				}
+			}
+
+			if (last - first > 1)
+				insertion_sort_strings(first, last, depth);
+		}
+
+		inline void sort_strings_sequential(std::span<string_view> strings)
+		{
+			std::vector<string_sort_entry> entries(strings.size());
+			for (size_t i = 0; i < strings.size(); ++i)
+			{
+				entries[i].str = strings[i];
+				entries[i].load(0);
+			}
+			multikey_quicksort(entries.data(), entries.data() + entries.size(), 0);
+			for (size_t i = 0; i < strings.size(); ++i)
+				strings[i] = entries[i].str;
+		}
+	}
+
+	/// Sorts by byte order (same as `std::sort` with `operator<`). Large inputs are split into one run per hardware thread,
+	/// sorted concurrently and merged pairwise in parallel.
+	inline void sort_strings(std::span<string_view> strings)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(sort_strings, 0);
+		static constexpr size_t min_strings_per_thread = 65536;
+
+		const size_t count = strings.size();
+		const size_t runs = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count / min_strings_per_thread);
+		if (runs <= 1)
+			return detail::sort_strings_sequential(strings);
+
+		const size_t run_size = (count + runs - 1) / runs;
+		detail::parallel_for_chunks(runs, 1, [&](size_t begin, size_t end) {
+			for (size_t run = begin; run < end; ++run)
+				detail::sort_strings_sequential(strings.subspan(run * run_size, std::min(run_size, count - run * run_size)));
+		});
+
+		std::vector<string_view> buffer(count);
+		std::span<string_view> from = strings, to = buffer;
+		for (size_t width = run_size; width < count; width *= 2)
+		{
+			const size_t pairs = (count + 2 * width - 1) / (2 * width);
+			detail::parallel_for_chunks(pairs, 1, [&](size_t begin, size_t end) {
+				for (size_t pair = begin; pair < end; ++pair)
+				{
+					const auto lo = pair * 2 * width, mid = std::min(count, lo + width), hi = std::min(count, lo + 2 * width);
+					std::merge(from.begin() + lo, from.begin() + mid, from.begin() + mid, from.begin() + hi, to.begin() + lo);
+				}
+			});
+			std::swap(from, to);
+		}
+
+		if (from.data() != strings.data())
+			std::copy(from.begin(), from.end(), strings.begin());
+	}
+
+	/// Sorts `strings` and returns the leading subspan with each distinct string once; elements past its end are left with unspecified values, like with `std::unique`
+	inline std::span<string_view> unique_strings(std::span<string_view> strings)
+	{
+		sort_strings(strings);
+		return strings.first(size_t(std::unique(strings.begin(), strings.end()) - strings.begin()));
+	}
+
+	/// ///////////////////////////// ///
+	/// Approximate matching
+	/// ///////////////////////////// ///
+
+	namespace detail
+	{
+		/// Myers' bit-vector Levenshtein algorithm, with Hyyrö's blocking for patterns longer than 64 characters.
+		/// Build once per pattern, then compare against any number of texts.
+		class bit_parallel_pattern
+		{
+		public:
+
+			bit_parallel_pattern(string_view pattern, bool ignore_case)
+				: m_length(pattern.size()), m_blocks(std::max<size_t>(1, (pattern.size() + 63) / 64))
+			{
+				if (m_blocks > 1)
+					m_large_peq.assign(256 * m_blocks, 0);
+
+				for (size_t i = 0; i < pattern.size(); ++i)
+				{
+					const auto bit = uint64_t(1) << (i % 64);
+					const auto c = uint8_t(pattern[i]);
+					peq(c)[i / 64] |= bit;
+					if (ignore_case)
+					{
+						peq(uint8_t(ascii::toupper(char32_t(c))))[i / 64] |= bit;
+						peq(uint8_t(ascii::tolower(char32_t(c))))[i / 64] |= bit;
+					}
+				}
+			}
+
+			[[nodiscard]] size_t size() const noexcept { return m_length; }
+
+			/// Edit distance to `text`, or `max_distance + 1` as soon as it is known to be larger than `max_distance`
+			[[nodiscard]] size_t distance(string_view text, size_t max_distance) const
+			{
+				const size_t m = m_length, n = text.size();
+				max_distance = std::min(max_distance, std::max(m, n));
+				if ((m > n ? m - n : n - m) > max_distance)
+					return max_distance + 1;
+				if (m == 0)
+					return n;
+
+				size_t score = m;
+
+				if (m_blocks == 1)
+				{
+					const uint64_t high = uint64_t(1) << (m - 1);
+					uint64_t pv = ~uint64_t(0), mv = 0;
+					for (size_t j = 0; j < n; ++j)
+					{
+						const uint64_t eq = m_small_peq[uint8_t(text[j])];
+						const uint64_t xv = eq | mv;
+						const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+						uint64_t ph = mv | ~(xh | pv);
+						uint64_t mh = pv & xh;
+						if (ph & high) ++score;
+						else if (mh & high) --score;
+						if (score > max_distance + (n - j - 1)) /// the remaining characters can't bring it back down
+							return max_distance + 1;
+						ph = (ph << 1) | 1;
+						mh <<= 1;
+						pv = mh | ~(xv | ph);
+						mv = ph & xv;
+					}
+					return score;
+				}
+
+				std::vector<uint64_t> pv(m_blocks, ~uint64_t(0)), mv(m_blocks, 0);
+				const uint64_t last_high = uint64_t(1) << ((m - 1) % 64);
+				for (size_t j = 0; j < n; ++j)
+				{
+					const uint64_t* eqs = peq(uint8_t(text[j]));
+					int carry = 1;
+					for (size_t b = 0; b < m_blocks; ++b)
+					{
+						uint64_t eq = eqs[b];
+						const uint64_t xv = eq | mv[b];
+						if (carry < 0) eq |= 1;
+						const uint64_t xh = (((eq & pv[b]) + pv[b]) ^ pv[b]) | eq;
+						uint64_t ph = mv[b] | ~(xh | pv[b]);
+						uint64_t mh = pv[b] & xh;
+						const uint64_t high = b + 1 == m_blocks ? last_high : uint64_t(1) << 63;
+						const int carry_out = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+						ph <<= 1;
+						mh <<= 1;
+						if (carry < 0) mh |= 1;
+						else if (carry > 0) ph |= 1;
+						pv[b] = mh | ~(xv | ph);
+						mv[b] = ph & xv;
+						carry = carry_out;
+					}
+					score += carry;
+					if (score > max_distance + (n - j - 1))
+						return max_distance + 1;
+				}
+				return score;
+			}
+
+		private:
+
+			uint64_t* peq(uint8_t c) noexcept { return m_blocks > 1 ? m_large_peq.data() + size_t(c) * m_blocks : m_small_peq + c; }
+			uint64_t const* peq(uint8_t c) const noexcept { return m_blocks > 1 ? m_large_peq.data() + size_t(c) * m_blocks : m_small_peq + c; }
+
+			size_t m_length = 0;
+			size_t m_blocks = 1;
+			uint64_t m_small_peq[256]{};
+			std::vector<uint64_t> m_large_peq;
+		};
+	}
+
+	/// Levenshtein distance (insertions, deletions and substitutions all cost 1). With `ignore_case`, characters are compared like in `ascii::strings_equal_ignore_case`.
+	[[nodiscard]] inline size_t edit_distance(string_view a, string_view b, bool ignore_case = false)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(edit_distance, a.size() + b.size());
+		if (a.size() > b.size()) std::swap(a, b);
+		return detail::bit_parallel_pattern{ a, ignore_case }.distance(b, b.size());
+	}
+
+	/// Like `edit_distance`, but gives up early and returns `max_distance + 1` if the distance is larger than `max_distance`
+	[[nodiscard]] inline size_t bounded_edit_distance(string_view a, string_view b, size_t max_distance, bool ignore_case = false)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(edit_distance, a.size() + b.size());
+		if (a.size() > b.size()) std::swap(a, b);
+		const auto result = detail::bit_parallel_pattern{ a, ignore_case }.distance(b, max_distance);
+		return result > max_distance ? max_distance + 1 : result;
+	}
+
+	struct fuzzy_match
+	{
+		string_view word;
+		size_t index = 0; /// position of the word in the range the index was built from
+		size_t distance = 0;
+	};
+
+	/// A dictionary for "did you mean" lookups. Words are grouped by length and indexed by their distinct bigrams;
+	/// a query only verifies (with the bit-parallel edit distance) words whose length is within the distance limit,
+	/// which share enough bigrams with it, and whose character signature differs little enough to possibly be that close.
+	class fuzzy_index
+	{
+	public:
+
+		fuzzy_index() = default;
+
+		template <std::ranges::input_range RANGE>
+		explicit fuzzy_index(RANGE&& words, bool ignore_case = false)
+			: m_ignore_case(ignore_case)
+		{
+			std::string text;
+			for (auto&& word : words)
+			{
+				const auto view = string_view{ word };
+				m_words.push_back({ 0, text.size(), uint32_t(view.size()), uint32_t(m_words.size()) });
+				text += view;
+			}
+			build(text);
+		}
+
+		[[nodiscard]] size_t size() const noexcept { return m_words.size(); }
+		[[nodiscard]] bool ignores_case() const noexcept { return m_ignore_case; }
+		[[nodiscard]] string_view operator[](size_t index) const noexcept { return word_at_rank(m_rank_of[index]); }
+
+		/// Up to `count` words within `max_distance` of `query`, closest first (ties are ordered by index)
+		[[nodiscard]] std::vector<fuzzy_match> closest(string_view query, size_t count, size_t max_distance) const
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(fuzzy_lookup, query.size());
+			std::vector<fuzzy_match> result;
+			if (count == 0 || m_words.empty())
+				return result;
+
+			const query_state state{ detail::bit_parallel_pattern{ query, m_ignore_case }, signature(query), distinct_bigrams(query), count };
+
+			/// Look for exact distances in increasing order; small limits keep the bigram filter selective,
+			/// and once we have `count` matches no later pass could improve on them
+			std::vector<std::pair<size_t, size_t>> best; /// max-heap of (distance, index)
+			best.reserve(count + 1);
+			/// No edit distance exceeds the longer of the two strings, and `m_words` is sorted by length
+			const size_t max_limit = std::min(max_distance, std::max<size_t>(query.size(), m_words.back().size));
+			for (size_t limit = 0; limit <= max_limit && best.size() < count; ++limit)
+				find_at_distance(state, limit, best);
+
+			std::sort_heap(best.begin(), best.end());
+			result.reserve(best.size());
+			for (auto [distance, index] : best)
+				result.push_back({ (*this)[index], index, distance });
+			return result;
+		}
+
+	private:
+
+		struct query_state
+		{
+			detail::bit_parallel_pattern pattern;
+			uint64_t signature;
+			std::vector<uint16_t> bigrams;
+			size_t count;
+		};
+
+		/// Adds the words exactly `distance` away from the query to `best`, keeping at most `state.count` of them
+		void find_at_distance(query_state const& state, size_t distance, std::vector<std::pair<size_t, size_t>>& best) const
+		{
+			const size_t query_length = state.pattern.size();
+			const size_t max_length = m_length_start.size() - 2;
+			const size_t min_word_length = query_length > distance ? query_length - distance : 0;
+			if (min_word_length > max_length)
+				return;
+			const size_t first_rank = m_length_start[min_word_length];
+			const size_t last_rank = m_length_start[std::min(max_length, query_length + distance) + 1];
+
+			const auto consider = [&](size_t rank) {
+				if (size_t(std::popcount(m_words[rank].signature ^ state.signature)) > 2 * distance)
+					return;
+				if (state.pattern.distance(word_at_rank(rank), distance) != distance)
+					return;
+				const size_t index = m_words[rank].index;
+				if (best.size() == state.count)
+				{
+					if (index >= best.front().second)
+						return;
+					std::pop_heap(best.begin(), best.end());
+					best.pop_back();
+				}
+				best.emplace_back(distance, index);
+				std::push_heap(best.begin(), best.end());
+			};
+
+			const ptrdiff_t threshold = ptrdiff_t(state.bigrams.size()) - 2 * ptrdiff_t(std::min(distance, query_length));
+			if (threshold <= 0)
+			{
+				/// Too short for the q-gram filter to rule anything out
+				for (size_t rank = first_rank; rank < last_rank; ++rank)
+					consider(rank);
+				return;
+			}
+
+			/// Each edit destroys at most two of the query's bigrams, so a match shares at least `threshold` of them
+			std::vector<uint16_t> shared(last_rank - first_rank);
+			for (const auto gram : state.bigrams)
+			{
+				const auto postings_begin = m_postings.begin() + m_posting_start[gram], postings_end = m_postings.begin() + m_posting_start[gram + 1];
+				for (auto it = std::lower_bound(postings_begin, postings_end, uint32_t(first_rank)); it != postings_end && *it < last_rank; ++it)
+				{
+					if (++shared[*it - first_rank] == threshold)
+						consider(*it);
+				}
+			}
+		}
+
+		/// Which of 64 character classes occur in the word; one edit changes at most two bits
+		uint64_t signature(string_view word) const noexcept
+		{
+			uint64_t result = 0;
+			for (const auto c : word)
+				result |= uint64_t(1) << ((m_ignore_case ? ascii::toupper(c) : char32_t(uint8_t(c))) & 63);
+			return result;
+		}
+
+		std::vector<uint16_t> distinct_bigrams(string_view word) const
+		{
+			std::vector<uint16_t> result;
+			for (size_t i = 1; i < word.size(); ++i)
+			{
+				const auto a = uint8_t(m_ignore_case ? ascii::toupper(word[i - 1]) : word[i - 1]);
+				const auto b = uint8_t(m_ignore_case ? ascii::toupper(word[i]) : word[i]);
+				result.push_back(uint16_t((a << 8) | b));
+			}
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+			return result;
+		}
+
+		string_view word_at_rank(size_t rank) const noexcept { return string_view{ m_text }.substr(m_words[rank].offset, m_words[rank].size); }
+
+		/// Lays the words out by length so that scanning a length range reads memory sequentially
+		void build(std::string const& text)
+		{
+			std::stable_sort(m_words.begin(), m_words.end(), [](word_entry const& a, word_entry const& b) { return a.size < b.size; });
+
+			m_text.reserve(text.size());
+			m_rank_of.resize(m_words.size());
+			for (size_t rank = 0; rank < m_words.size(); ++rank)
+			{
+				auto& word = m_words[rank];
+				const auto view = string_view{ text }.substr(word.offset, word.size);
+				word.offset = m_text.size();
+				word.signature = signature(view);
+				m_text += view;
+				m_rank_of[word.index] = uint32_t(rank);
+			}
+
+			const size_t max_length = m_words.empty() ? 0 : m_words.back().size;
+			m_length_start.assign(max_length + 2, 0);
+			for (size_t length = 0, rank = 0; length < m_length_start.size(); ++length)
+			{
+				while (rank < m_words.size() && m_words[rank].size < length)
+					++rank;
+				m_length_start[length] = uint32_t(rank);
+			}
+
+			m_posting_start.assign(65537, 0);
+			for (size_t rank = 0; rank < m_words.size(); ++rank)
+				for (const auto gram : distinct_bigrams(word_at_rank(rank)))
+					++m_posting_start[gram + 1];
+			for (size_t i = 1; i < m_posting_start.size(); ++i)
+				m_posting_start[i] += m_posting_start[i - 1];
+
+			m_postings.resize(m_posting_start.back());
+			auto fill = m_posting_start;
+			for (uint32_t rank = 0; rank < m_words.size(); ++rank)
+				for (const auto gram : distinct_bigrams(word_at_rank(rank)))
+					m_postings[fill[gram]++] = rank;
+		}
+
+		struct word_entry
+		{
+			uint64_t signature;
+			size_t offset;
+			uint32_t size;
+			uint32_t index;
+		};
+
+		bool m_ignore_case = false;
+		std::string m_text;                       /// all words, in rank order
+		std::vector<word_entry> m_words;          /// stable-sorted by length; positions in here are "ranks"
+		std::vector<uint32_t> m_rank_of;          /// rank of each word, by insertion index
+		std::vector<uint32_t> m_length_start;     /// first rank of a word at least this long
+		std::vector<uint32_t> m_posting_start;    /// offsets into `m_postings` for each of the 65536 bigrams
+		std::vector<uint32_t> m_postings;         /// ranks containing each bigram, ascending
+	};
+
+	/// ///////////////////////////// ///
+	/// Lexer
+	/// ///////////////////////////// ///
+
+	/// Builds a table-driven DFA lexer at compile time from a list of token rules:
+	///
+	///   constexpr auto lexer = lex::compile([] {
+	///     return std::vector<lex::rule>{ lex::literal("if"), lex::c_identifier(), lex::c_integer(), lex::skip(lex::whitespace()) };
+	///   });
+	///   while (auto token = lexer.consume(str)) ... /// token.kind is the index of the rule that matched
+	///
+	/// Matching is longest-match; when two rules match the same length, the earlier one wins (so list keywords before identifiers).
+	/// Every byte is looked up once in a `states * byte classes` transition table; bytes past the end of the longest match are re-read
+	/// only when a longer candidate fails (e.g. `1e` with `c_float`).
+	/// Building the DFA is not free: a C-sized set of ~70 keywords, operators and literals compiles in a few seconds.
+	namespace lex
+	{
+		/// A set of bytes
+		class char_set
+		{
+		public:
+
+			constexpr char_set() noexcept = default;
+			constexpr char_set(char c) noexcept { insert(uint8_t(c)); }
+			constexpr explicit char_set(string_view chars) noexcept { for (const auto c : chars) insert(uint8_t(c)); }
+			/// For the `ascii::` classification functions
+			constexpr explicit char_set(bool (*predicate)(char32_t)) noexcept { for (int c = 0; c < 256; ++c) if (predicate(char32_t(c))) insert(uint8_t(c)); }
+
+			[[nodiscard]] static constexpr char_set range(char from, char to) noexcept { char_set result; for (int c = uint8_t(from); c <= uint8_t(to); ++c) result.insert(uint8_t(c)); return result; }
+			[[nodiscard]] static constexpr char_set any() noexcept { return ~char_set{}; }
+
+			constexpr void insert(uint8_t c) noexcept { m_bits[c / 64] |= uint64_t(1) << (c % 64); }
+			[[nodiscard]] constexpr bool contains(uint8_t c) const noexcept { return (m_bits[c / 64] >> (c % 64)) & 1; }
+			[[nodiscard]] constexpr bool empty() const noexcept { return (m_bits[0] | m_bits[1] | m_bits[2] | m_bits[3]) == 0; }
+
+			[[nodiscard]] constexpr char_set operator~() const noexcept { char_set result; for (int i = 0; i < 4; ++i) result.m_bits[i] = ~m_bits[i]; return result; }
+			[[nodiscard]] friend constexpr char_set operator|(char_set a, char_set b) noexcept { for (int i = 0; i < 4; ++i) a.m_bits[i] |= b.m_bits[i]; return a; }
+			[[nodiscard]] friend constexpr char_set operator&(char_set a, char_set b) noexcept { for (int i = 0; i < 4; ++i) a.m_bits[i] &= b.m_bits[i]; return a; }
+			[[nodiscard]] friend constexpr bool operator==(char_set const&, char_set const&) noexcept = default;
+
+		private:
+
+			uint64_t m_bits[4]{};
+		};
+
+		/// A regular expression, kept as a Thompson NFA: state 0 is the start, the last state is the only accepting one and has no outgoing edges.
+		/// Only meant to be built during constant evaluation (inside the function passed to `compile`).
+		class pattern
+		{
+		public:
+
+			constexpr pattern(char_set set) : m_states(2) { m_states[0].on = set; m_states[0].target = 1; }
+			constexpr pattern(char c) : pattern(char_set{ c }) {}
+
+			[[nodiscard]] friend constexpr pattern operator+(pattern a, pattern const& b)
+			{
+				const auto offset = a.m_states.size();
+				a.m_states.back().epsilon.push_back(offset);
+				a.append(b, offset);
+				return a;
+			}
+
+			[[nodiscard]] friend constexpr pattern operator|(pattern const& a, pattern const& b)
+			{
+				auto result = with_states(1);
+				result.m_states[0].epsilon = { 1, 1 + a.m_states.size() };
+				result.append(a, 1);
+				result.append(b, 1 + a.m_states.size());
+				const auto accept = result.m_states.size();
+				result.m_states[a.m_states.size()].epsilon.push_back(accept);
+				result.m_states[accept - 1].epsilon.push_back(accept);
+				result.m_states.emplace_back();
+				return result;
+			}
+
+			friend constexpr pattern literal(string_view str);
+			friend constexpr pattern zero_or_more(pattern const& p);
+			friend constexpr pattern one_or_more(pattern const& p);
+			friend constexpr pattern optional(pattern const& p);
+
+		private:
+
+			friend struct dfa_builder;
+
+			struct state
+			{
+				char_set on;
+				size_t target = string_view::npos;
+				std::vector<size_t> epsilon;
+			};
+
+			constexpr pattern() = default;
+
+			[[nodiscard]] static constexpr pattern with_states(size_t count)
+			{
+				pattern result;
+				result.m_states.resize(count);
+				return result;
+			}
+
+			constexpr void append(pattern const& other, size_t offset)
+			{
+				for (auto s : other.m_states)
+				{
+					if (s.target != string_view::npos) s.target += offset;
+					for (auto& e : s.epsilon) e += offset;
+					m_states.push_back(std::move(s));
+				}
+			}
+
+			constexpr pattern repeated(bool allow_none, bool allow_many) const
+			{
+				auto result = with_states(1);
+				result.append(*this, 1);
+				const auto inner_accept = result.m_states.size() - 1;
+				const auto accept = result.m_states.size();
+				result.m_states[0].epsilon.push_back(1);
+				if (allow_none) result.m_states[0].epsilon.push_back(accept);
+				if (allow_many) result.m_states[inner_accept].epsilon.push_back(1);
+				result.m_states[inner_accept].epsilon.push_back(accept);
+				result.m_states.emplace_back();
+				return result;
+			}
+
+			std::vector<state> m_states;
+		};
+
+		[[nodiscard]] constexpr pattern literal(string_view str)
+		{
+			auto result = pattern::with_states(str.size() + 1);
+			for (size_t i = 0; i < str.size(); ++i)
+			{
+				result.m_states[i].on = char_set{ str[i] };
+				result.m_states[i].target = i + 1;
+			}
+			return result;
+		}
+
+		[[nodiscard]] constexpr pattern zero_or_more(pattern const& p) { return p.repeated(true, true); }
+		[[nodiscard]] constexpr pattern one_or_more(pattern const& p) { return p.repeated(false, true); }
+		[[nodiscard]] constexpr pattern optional(pattern const& p) { return p.repeated(true, false); }
+
+		/// Patterns matching what the corresponding `consume_*` functions accept
+		[[nodiscard]] constexpr pattern c_identifier() { return pattern{ char_set{ ascii::isalpha } | char_set{ '_' } } + zero_or_more(char_set{ ascii::isident }); }
+		[[nodiscard]] constexpr pattern c_integer() { return optional('-') + one_or_more(char_set{ ascii::isdigit }); }
+		/// Decimal notation only (no `inf`, `nan` or hex floats)
+		[[nodiscard]] constexpr pattern c_float()
+		{
+			const pattern digits = one_or_more(char_set{ ascii::isdigit });
+			return optional('-') + digits + optional('.' + zero_or_more(char_set{ ascii::isdigit })) + optional(char_set{ "eE" } + optional(char_set{ "+-" }) + digits);
+		}
+		/// The shape of a string literal; escapes are only validated when decoding it with `consume_c_string`
+		[[nodiscard]] constexpr pattern c_string() { return '"' + zero_or_more(pattern{ ~char_set{ "\"\\" } } | ('\\' + pattern{ char_set::any() })) + '"'; }
+		[[nodiscard]] constexpr pattern whitespace() { return one_or_more(char_set{ ascii::isspace }); }
+
+		struct rule
+		{
+			constexpr rule(pattern p, bool skipped = false) : match(std::move(p)), skip(skipped) {}
+
+			pattern match;
+			bool skip = false; /// matched but never returned, e.g. whitespace and comments
+		};
+
+		[[nodiscard]] constexpr rule skip(pattern p) { return rule{ std::move(p), true }; }
+
+		inline constexpr size_t no_match = size_t(-1);
+
+		struct token
+		{
+			size_t kind = no_match; /// index of the rule that matched
+			string_view text;
+
+			[[nodiscard]] explicit constexpr operator bool() const noexcept { return kind != no_match; }
+		};
+
+		/// Subset construction of the rules' NFA into a DFA over byte equivalence classes
+		struct dfa_builder
+		{
+			struct tables
+			{
+				size_t state_count = 0; /// state 0 is the dead state, state 1 the start state
+				size_t class_count = 0;
+				uint8_t byte_class[256]{};
+				std::vector<uint16_t> next; /// `state_count * class_count`
+				std::vector<uint16_t> accept; /// rule index + 1, or 0
+				std::vector<bool> skip;
+			};
+
+			/// Written with flat, presized vectors and raw pointers, and without lambdas in the inner loops, because
+			/// this runs in the constant evaluator, where each of those costs hundreds of operations (GCC gives up after 2^25)
+			static constexpr tables build(std::vector<rule> const& rules)
+			{
+				constexpr size_t none = string_view::npos;
+				tables result;
+				for (auto& r : rules)
+					result.skip.push_back(r.skip);
+
+				/// All rules' states one after another, after a common start state (0) with an epsilon edge to each rule's start
+				std::vector<pattern::state const*> nfa{ nullptr };
+				std::vector<size_t> offset_of;
+				std::vector<size_t> accepting_rule{ none };
+				for (size_t r = 0; r < rules.size(); ++r)
+				{
+					offset_of.push_back(nfa.size());
+					for (auto& s : rules[r].match.m_states)
+					{
+						nfa.push_back(&s);
+						accepting_rule.push_back(none);
+					}
+					accepting_rule.back() = r;
+				}
+				std::vector<size_t> rule_of(nfa.size(), 0);
+				for (size_t r = 0; r < rules.size(); ++r)
+					for (size_t i = 0; i < rules[r].match.m_states.size(); ++i)
+						rule_of[offset_of[r] + i] = r;
+
+				const size_t count = nfa.size();
+				std::vector<size_t> target(count, none);
+				for (size_t i = 1; i < count; ++i)
+					if (nfa[i]->target != none)
+						target[i] = offset_of[rule_of[i]] + nfa[i]->target;
+
+				/// Split all bytes into classes that no transition can tell apart
+				std::vector<char_set> classes{ char_set::any() };
+				for (size_t i = 1; i < count; ++i)
+				{
+					if (target[i] == none)
+						continue;
+					for (size_t c = 0, class_count = classes.size(); c < class_count; ++c)
+					{
+						const auto in = classes[c] & nfa[i]->on;
+						if (in.empty() || in == classes[c])
+							continue;
+						classes.push_back(classes[c] & ~nfa[i]->on);
+						classes[c] = in;
+					}
+				}
+				const size_t class_count = result.class_count = classes.size();
+				std::vector<uint8_t> representative(class_count);
+				for (size_t c = 0; c < class_count; ++c)
+				{
+					for (int b = 255; b >= 0; --b)
+					{
+						if (classes[c].contains(uint8_t(b)))
+						{
+							result.byte_class[b] = uint8_t(c);
+							representative[c] = uint8_t(b);
+						}
+					}
+				}
+
+				/// The classes each NFA state has a transition on, as ranges of `class_list`
+				std::vector<size_t> class_list_start(count + 1, 0), class_list;
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (target[i] != none)
+						for (size_t c = 0; c < class_count; ++c)
+							if (nfa[i]->on.contains(representative[c]))
+								class_list.push_back(c);
+					class_list_start[i + 1] = class_list.size();
+				}
+
+				/// Epsilon closure of every NFA state, as `words`-long bitsets
+				const size_t words = (count + 63) / 64;
+				std::vector<uint64_t> closures(count * words, 0);
+				std::vector<size_t> pending(count);
+				for (size_t s = 0; s < count; ++s)
+				{
+					uint64_t* set = closures.data() + s * words;
+					set[s / 64] |= uint64_t(1) << (s % 64);
+					size_t pending_count = 0;
+					pending[pending_count++] = s;
+					while (pending_count)
+					{
+						const auto i = pending[--pending_count];
+						const auto edges = i == 0 ? offset_of.size() : nfa[i]->epsilon.size();
+						for (size_t k = 0; k < edges; ++k)
+						{
+							const auto e = i == 0 ? offset_of[k] : offset_of[rule_of[i]] + nfa[i]->epsilon[k];
+							if (!((set[e / 64] >> (e % 64)) & 1))
+							{
+								set[e / 64] |= uint64_t(1) << (e % 64);
+								pending[pending_count++] = e;
+							}
+						}
+					}
+				}
+
+				/// DFA states (state 0 is dead, i.e. the empty set) are deduplicated through an open-addressing hash table
+				std::vector<uint64_t> dfa(words * 64, 0);
+				size_t dfa_count = 1;
+				std::vector<size_t> slots(64, none);
+				std::vector<uint64_t> moved(words);
+				auto find_or_add = [&]() -> size_t {
+					uint64_t hash = 14695981039346656037ull;
+					for (size_t w = 0; w < words; ++w)
+						hash = (hash ^ moved[w]) * 1099511628211ull;
+					auto slot = size_t(hash ^ (hash >> 29)) & (slots.size() - 1);
+					for (; slots[slot] != none; slot = (slot + 1) & (slots.size() - 1))
+					{
+						const uint64_t* existing = dfa.data() + slots[slot] * words;
+						size_t w = 0;
+						while (w < words && existing[w] == moved[w]) ++w;
+						if (w == words)
+							return slots[slot];
+					}
+
+					if ((dfa_count + 1) * words > dfa.size())
+						dfa.resize(dfa.size() * 2);
+					std::copy(moved.begin(), moved.end(), dfa.begin() + ptrdiff_t(dfa_count * words));
+					slots[slot] = dfa_count++;
+
+					if (dfa_count * 2 >= slots.size())
+					{
+						slots.assign(slots.size() * 2, none);
+						for (size_t d = 1; d < dfa_count; ++d)
+						{
+							hash = 14695981039346656037ull;
+							for (size_t w = 0; w < words; ++w)
+								hash = (hash ^ dfa[d * words + w]) * 1099511628211ull;
+							slot = size_t(hash ^ (hash >> 29)) & (slots.size() - 1);
+							while (slots[slot] != none) slot = (slot + 1) & (slots.size() - 1);
+							slots[slot] = d;
+						}
+					}
+					return dfa_count - 1;
+				};
+				std::copy_n(closures.begin(), words, moved.begin());
+				find_or_add();
+
+				/// Most classes of a DFA state move the same subset of its NFA states (e.g. every letter that is not the next one of some keyword),
+				/// so each distinct subset is only closed over and looked up once
+				std::vector<size_t> members(count);
+				std::vector<uint64_t> moving(class_count * words); /// per class, a bitset over `members`
+				std::vector<uint64_t> known_moves(class_count * words);
+				std::vector<size_t> known_targets(class_count);
+				result.next.resize(class_count * 64);
+				result.accept.resize(64);
+				const size_t* const list_start = class_list_start.data();
+				const size_t* const list = class_list.data();
+				for (size_t d = 0; d < dfa_count; ++d)
+				{
+					if (d == result.accept.size())
+					{
+						result.accept.resize(d * 2);
+						result.next.resize(d * 2 * class_count);
+					}
+
+					size_t accepted = none;
+					size_t member_count = 0;
+					for (size_t w = 0; w < words; ++w)
+					{
+						for (auto bits = dfa[d * words + w]; bits; bits &= bits - 1)
+						{
+							const auto i = w * 64 + size_t(std::countr_zero(bits));
+							if (accepting_rule[i] < accepted)
+								accepted = accepting_rule[i];
+							if (list_start[i] != list_start[i + 1])
+								members[member_count++] = i;
+						}
+					}
+					result.accept[d] = accepted != none ? uint16_t(accepted + 1) : 0;
+
+					const size_t mask_words = (member_count + 63) / 64;
+					uint64_t* const moving_bits = moving.data();
+					for (size_t i = 0; i < class_count * mask_words; ++i)
+						moving_bits[i] = 0;
+					for (size_t m = 0; m < member_count; ++m)
+						for (size_t l = list_start[members[m]]; l < list_start[members[m] + 1]; ++l)
+							moving_bits[list[l] * mask_words + m / 64] |= uint64_t(1) << (m % 64);
+
+					size_t known_count = 0;
+					uint64_t* const known_bits = known_moves.data();
+					size_t* const known_next = known_targets.data();
+					uint16_t* const next_of = result.next.data() + d * class_count;
+					const size_t* const member_of = members.data();
+					for (size_t c = 0; c < class_count; ++c)
+					{
+						const uint64_t* mask = moving_bits + c * mask_words;
+
+						size_t next = none;
+						for (size_t k = 0; k < known_count && next == none; ++k)
+						{
+							const uint64_t* other = known_bits + k * mask_words;
+							size_t w = 0;
+							while (w < mask_words && other[w] == mask[w]) ++w;
+							if (w == mask_words)
+								next = known_next[k];
+						}
+						if (next == none)
+						{
+							for (size_t t = 0; t < words; ++t)
+								moved[t] = 0;
+							bool any = false;
+							for (size_t w = 0; w < mask_words; ++w)
+							{
+								for (auto bits = mask[w]; bits; bits &= bits - 1)
+								{
+									const uint64_t* targets = closures.data() + target[member_of[w * 64 + size_t(std::countr_zero(bits))]] * words;
+									for (size_t t = 0; t < words; ++t)
+										moved[t] |= targets[t];
+									any = true;
+								}
+							}
+							next = any ? find_or_add() : 0;
+							for (size_t w = 0; w < mask_words; ++w)
+								known_bits[known_count * mask_words + w] = mask[w];
+							known_next[known_count++] = next;
+						}
+						next_of[c] = uint16_t(next);
+					}
+				}
+				result.accept.resize(dfa_count);
+				result.next.resize(dfa_count * class_count);
+				result.state_count = dfa_count;
+				return result;
+			}
+		};
+
+		template <size_t STATES, size_t CLASSES, size_t RULES>
+		class lexer
+		{
+		public:
+
+			/// The longest token at the start of `str` (skip rules included), or one with `kind == no_match`
+			[[nodiscard]] constexpr token match(string_view str) const noexcept
+			{
+				size_t rule = 0, length = 0;
+				size_t state = 1;
+				for (size_t i = 0; i < str.size(); ++i)
+				{
+					state = m_next[state * CLASSES + m_byte_class[uint8_t(str[i])]];
+					if (state == 0)
+						break;
+					if (m_accept[state])
+					{
+						rule = m_accept[state];
+						length = i + 1;
+					}
+				}
+				return { rule - 1, str.substr(0, length) }; /// `no_match` is `size_t(-1)`
+			}
+
+			/// Removes skipped tokens and then the next token from the start of `str`.
+			/// Returns a token with `kind == no_match` at the end of input, or if nothing matches (in which case `str` starts at the offending byte).
+			constexpr token consume(string_view& str) const noexcept
+			{
+				while (!str.empty())
+				{
+					const auto result = match(str);
+					if (!result)
+						break;
+					str.remove_prefix(result.text.size());
+					if (!m_skip[result.kind])
+						return result;
+				}
+				return { no_match, str.substr(0, 0) };
+			}
+
+			/// Calls `func(token)` for every token in `str`; returns the part of `str` that could not be lexed (empty on success)
+			template <typename FUNC>
+			requires std::invocable<FUNC&, token>
+			constexpr string_view tokenize(string_view str, FUNC&& func) const
+			{
+				while (const auto result = consume(str))
+					func(result);
+				return str;
+			}
+
+			template <typename ALLOC>
+			string_view tokenize(string_view str, std::vector<token, ALLOC>& out) const
+			{
+				return tokenize(str, [&out](token const& t) { out.push_back(t); });
+			}
+
+			[[nodiscard]] static constexpr size_t state_count() noexcept { return STATES; }
+			[[nodiscard]] static constexpr size_t rule_count() noexcept { return RULES; }
+
+		private:
+
+			template <typename SPEC>
+			friend consteval auto compile(SPEC);
+
+			uint8_t m_byte_class[256]{};
+			uint16_t m_next[STATES * CLASSES]{};
+			uint16_t m_accept[STATES]{};
+			bool m_skip[RULES]{};
+		};
+
+		/// The tables built from `SPEC{}()`, copied into fixed storage so that they can be kept in a `static constexpr`.
+		/// That way `compile` builds the DFA once per spec, and only for lexers whose tables exceed `capacity` entries a second time.
+		template <typename SPEC>
+		struct built_tables
+		{
+			static constexpr size_t capacity = size_t{ 1 } << 16;
+
+			size_t state_count = 0;
+			size_t class_count = 0;
+			size_t rule_count = 0;
+			bool fits = false;
+			uint8_t byte_class[256]{};
+			uint16_t data[capacity]{}; /// `next`, then `accept`, then `skip`
+
+			static constexpr built_tables build()
+			{
+				built_tables result;
+				const auto tables = dfa_builder::build(SPEC{}());
+				result.state_count = tables.state_count;
+				result.class_count = tables.class_count;
+				result.rule_count = tables.skip.size();
+				std::copy_n(tables.byte_class, 256, result.byte_class);
+				result.fits = tables.next.size() + tables.accept.size() + tables.skip.size() <= capacity;
+				if (result.fits)
+				{
+					auto out = std::copy(tables.next.begin(), tables.next.end(), result.data);
+					out = std::copy(tables.accept.begin(), tables.accept.end(), out);
+					std::copy(tables.skip.begin(), tables.skip.end(), out);
+				}
+				return result;
+			}
+
+			static constexpr built_tables value = build();
+		};
+
+		/// `spec` must be a captureless lambda returning a `std::vector<lex::rule>`; it is evaluated at compile time
+		template <typename SPEC>
+		[[nodiscard]] consteval auto compile(SPEC)
+		{
+			constexpr auto const& built = built_tables<SPEC>::value;
+			static_assert(built.state_count <= 65536, "lexer has too many states");
+
+			lexer<built.state_count, built.class_count, built.rule_count> result;
+			std::copy_n(built.byte_class, 256, result.m_byte_class);
+			if constexpr (built.fits)
+			{
+				const auto next = built.data, accept = next + built.state_count * built.class_count, skip = accept + built.state_count;
+				std::copy(next, accept, result.m_next);
+				std::copy(accept, skip, result.m_accept);
+				std::copy(skip, skip + built.rule_count, result.m_skip);
+			}
+			else
+			{
+				const auto tables = dfa_builder::build(SPEC{}());
+				std::copy(tables.next.begin(), tables.next.end(), result.m_next);
+				std::copy(tables.accept.begin(), tables.accept.end(), result.m_accept);
+				std::copy(tables.skip.begin(), tables.skip.end(), result.m_skip);
+			}
+			return result;
+		}
+	}
+
+	/// ///////////////////////////// ///
+	/// Glob patterns
+	/// ///////////////////////////// ///
+
+	/// A shell-style wildcard pattern: `*` matches any run of bytes, `?` any single byte, `[a-f_]` a byte from a set (`[!...]` or `[^...]`
+	/// for the complement, `]` first to include it), and `\` escapes the next character. `/` is not special.
+	/// The pattern is compiled once into the segments between `*`s. The first and last segments are anchored and checked before anything else,
+	/// and the ones in between are found left to right, taking the leftmost occurrence each time. That is always correct for `*`, so matching
+	/// never backtracks and takes at most O(text size * segment size).
+	class glob_pattern
+	{
+	public:
+
+		explicit glob_pattern(string_view pattern, bool ignore_case = false)
+			: m_ignore_case(ignore_case)
+		{
+			m_segments.push_back({ 0, 0, true });
+			while (!pattern.empty())
+			{
+				const auto c = consume(pattern);
+				if (c == '*')
+				{
+					m_segments.push_back({ m_bytes.size(), 0, true });
+					continue;
+				}
+
+				lex::char_set set;
+				if (c == '?')
+					set = lex::char_set::any();
+				else if (c != '[' || !parse_set(pattern, set, m_ignore_case))
+				{
+					const auto literal = c == '\\' && !pattern.empty() ? consume(pattern) : c;
+					add_atom(m_ignore_case ? char(ascii::tolower(literal)) : literal, no_set);
+					continue;
+				}
+
+				auto existing = std::find(m_sets.begin(), m_sets.end(), set);
+				if (existing == m_sets.end())
+					existing = m_sets.insert(m_sets.end(), set);
+				add_atom('\0', uint16_t(existing - m_sets.begin()));
+				m_segments.back().literal = false;
+			}
+
+			for (auto& seg : m_segments)
+			{
+				m_min_size += seg.size;
+
+				/// The longest run of plain bytes is a substring of every match
+				for (size_t start = seg.first; start < seg.first + seg.size; )
+				{
+					size_t end = start;
+					while (end < seg.first + seg.size && m_set_of[end] == no_set)
+						++end;
+					if (end - start > m_required.second)
+						m_required = { start, end - start };
+					start = end + 1;
+				}
+			}
+		}
+
+		[[nodiscard]] bool match(string_view str) const noexcept
+		{
+			if (str.size() < m_min_size)
+				return false;
+
+			auto const& first = m_segments.front();
+			if (m_segments.size() == 1)
+				return str.size() == first.size && matches_at(first, str.data());
+
+			auto const& last = m_segments.back();
+			if (!matches_at(first, str.data()) || !matches_at(last, str.data() + str.size() - last.size))
+				return false;
+
+			size_t position = first.size;
+			const size_t end = str.size() - last.size;
+			for (size_t s = 1; s + 1 < m_segments.size(); ++s)
+			{
+				const auto found = find(m_segments[s], str, position, end);
+				if (found == string_view::npos)
+					return false;
+				position = found + m_segments[s].size;
+			}
+			return true;
+		}
+
+		/// Sets `results[i]` to whether `strings[i]` matches; returns the number of matches
+		template <typename ALLOC>
+		size_t match_all(std::span<const string_view> strings, std::vector<bool, ALLOC>& results) const
+		{
+			results.assign(strings.size(), false);
+			size_t matches = 0;
+			for (size_t i = 0; i < strings.size(); ++i)
+			{
+				if (match(strings[i]))
+				{
+					results[i] = true;
+					++matches;
+				}
+			}
+			return matches;
+		}
+
+		/// The longest literal that every matching string contains (lowercase if case is ignored), for use with external indexes
+		[[nodiscard]] string_view required_literal() const noexcept { return string_view{ m_bytes }.substr(m_required.first, m_required.second); }
+		/// The size of the shortest matching string
+		[[nodiscard]] size_t min_size() const noexcept { return m_min_size; }
+		[[nodiscard]] bool ignores_case() const noexcept { return m_ignore_case; }
+
+	private:
+
+		static constexpr uint16_t no_set = 0xFFFF;
+
+		struct segment
+		{
+			size_t first; /// index of the first atom
+			size_t size;
+			bool literal; /// no `?` or sets, so `m_bytes` holds it as-is
+		};
+
+		void add_atom(char byte, uint16_t set)
+		{
+			m_bytes.push_back(byte);
+			m_set_of.push_back(set);
+			++m_segments.back().size;
+		}
+
+		/// `pattern` starts just after the `[`; leaves it unchanged and returns false if the set is not closed.
+		/// With `ignore_case`, letters are folded into the set before it is complemented, so `[!a]` excludes both `a` and `A`
+		static bool parse_set(string_view& pattern, lex::char_set& set, bool ignore_case)
+		{
+			auto view = pattern;
+			const bool negated = consume(view, '!') || consume(view, '^');
+			bool first = true;
+			while (!view.empty() && (first || view[0] != ']'))
+			{
+				first = false;
+				auto from = consume(view);
+				if (from == '\\' && !view.empty())
+					from = consume(view);
+				auto to = from;
+				if (view.size() >= 2 && view[0] == '-' && view[1] != ']')
+				{
+					view.remove_prefix(1);
+					to = consume(view);
+					if (to == '\\' && !view.empty())
+						to = consume(view);
+				}
+				if (uint8_t(from) <= uint8_t(to))
+					set = set | lex::char_set::range(from, to);
+			}
+			if (!consume(view, ']'))
+				return false;
+			if (ignore_case)
+			{
+				for (int b = 'A'; b <= 'Z'; ++b)
+				{
+					if (set.contains(uint8_t(b)) || set.contains(uint8_t(b | 0x20)))
+					{
+						set.insert(uint8_t(b));
+						set.insert(uint8_t(b | 0x20));
+					}
+				}
+			}
+			if (negated)
+				set = ~set;
+			pattern = view;
+			return true;
+		}
+
+		[[nodiscard]] bool matches_at(segment const& seg, const char* text) const noexcept
+		{
+			const auto bytes = m_bytes.data() + seg.first;
+			if (seg.literal && !m_ignore_case)
+				return std::memcmp(text, bytes, seg.size) == 0;
+
+			const auto sets = m_set_of.data() + seg.first;
+			for (size_t i = 0; i < seg.size; ++i)
+			{
+				const auto c = text[i];
+				if (sets[i] != no_set ? !m_sets[sets[i]].contains(uint8_t(c)) : (m_ignore_case ? char(ascii::tolower(c)) : c) != bytes[i])
+					return false;
+			}
+			return true;
+		}
+
+		/// Leftmost position in [from, end - seg.size] at which `seg` matches, or npos
+		[[nodiscard]] size_t find(segment const& seg, string_view str, size_t from, size_t end) const noexcept
+		{
+			if (seg.size > end - from)
+				return string_view::npos;
+			if (seg.literal && !m_ignore_case)
+				return str.substr(0, end).find(string_view{ m_bytes }.substr(seg.first, seg.size), from);
+			for (size_t position = from; position + seg.size <= end; ++position)
+				if (matches_at(seg, str.data() + position))
+					return position;
+			return string_view::npos;
+		}
+
+		bool m_ignore_case = false;
+		std::string m_bytes;                 /// per atom, its byte (lowercase if ignoring case), or 0 for sets
+		std::vector<uint16_t> m_set_of;      /// per atom, its index into `m_sets`, or `no_set`
+		std::vector<lex::char_set> m_sets;
+		std::vector<segment> m_segments;     /// one more than there are `*`s
+		size_t m_min_size = 0;
+		std::pair<size_t, size_t> m_required{ 0, 0 };
+	};
+
+	/// ///////////////////////////// ///
+	/// String columns
+	/// ///////////////////////////// ///
+
+	/// A sequence of strings laid out like an Arrow string array: all bytes back to back in one buffer, plus `size() + 1` offsets into it.
+	/// Each field costs `sizeof(OFFSET)` bytes on top of its contents and there are no per-field allocations, so a column is a compact
+	/// target for `split`, `natural_split` and `consume_c_string`, and batch transforms run over one contiguous buffer.
+	/// Fields are read as `string_view`s, which stay valid until the column is modified. The total byte size must fit in `OFFSET`;
+	/// appending past that throws `std::length_error`.
+	template <std::unsigned_integral OFFSET = uint32_t, typename ALLOC = std::allocator<char>>
+	class basic_string_column
+	{
+	public:
+
+		using value_type = string_view;
+		using size_type = size_t;
+		using offset_type = OFFSET;
+		using allocator_type = ALLOC;
+
+		class const_iterator
+		{
+		public:
+
+			using iterator_concept = std::random_access_iterator_tag;
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = string_view;
+			using difference_type = std::ptrdiff_t;
+			using reference = string_view;
+			using pointer = void;
+
+			const_iterator() noexcept = default;
+
+			[[nodiscard]] string_view operator*() const noexcept { return (*m_column)[m_index]; }
+			[[nodiscard]] string_view operator[](difference_type n) const noexcept { return (*m_column)[m_index + n]; }
+
+			const_iterator& operator++() noexcept { ++m_index; return *this; }
+			const_iterator operator++(int) noexcept { auto copy = *this; ++m_index; return copy; }
+			const_iterator& operator--() noexcept { --m_index; return *this; }
+			const_iterator operator--(int) noexcept { auto copy = *this; --m_index; return copy; }
+			const_iterator& operator+=(difference_type n) noexcept { m_index += n; return *this; }
+			const_iterator& operator-=(difference_type n) noexcept { m_index -= n; return *this; }
+
+			[[nodiscard]] friend const_iterator operator+(const_iterator it, difference_type n) noexcept { return it += n; }
+			[[nodiscard]] friend const_iterator operator+(difference_type n, const_iterator it) noexcept { return it += n; }
+			[[nodiscard]] friend const_iterator operator-(const_iterator it, difference_type n) noexcept { return it -= n; }
+			[[nodiscard]] friend difference_type operator-(const_iterator const& a, const_iterator const& b) noexcept { return difference_type(a.m_index) - difference_type(b.m_index); }
+			[[nodiscard]] friend bool operator==(const_iterator const& a, const_iterator const& b) noexcept { return a.m_index == b.m_index; }
+			[[nodiscard]] friend auto operator<=>(const_iterator const& a, const_iterator const& b) noexcept { return a.m_index <=> b.m_index; }
+
+		private:
+
+			friend class basic_string_column;
+			const_iterator(basic_string_column const* column, size_t index) noexcept : m_column(column), m_index(index) {}
+
+			basic_string_column const* m_column = nullptr;
+			size_t m_index = 0;
+		};
+		using iterator = const_iterator;
+
+		basic_string_column() : basic_string_column(ALLOC{}) {}
+		explicit basic_string_column(ALLOC const& alloc)
+			: m_bytes(detail::rebind_alloc<ALLOC, char>(alloc))
+			, m_offsets(1, OFFSET{ 0 }, detail::rebind_alloc<ALLOC, OFFSET>(alloc))
+		{
+		}
+
+		[[nodiscard]] size_t size() const noexcept { return m_offsets.size() - 1; }
+		[[nodiscard]] bool empty() const noexcept { return m_offsets.size() == 1; }
+
+		[[nodiscard]] string_view operator[](size_t index) const noexcept { return { m_bytes.data() + m_offsets[index], size_t(m_offsets[index + 1] - m_offsets[index]) }; }
+		[[nodiscard]] string_view front() const noexcept { return (*this)[0]; }
+		[[nodiscard]] string_view back() const noexcept { return (*this)[size() - 1]; }
+
+		[[nodiscard]] const_iterator begin() const noexcept { return { this, 0 }; }
+		[[nodiscard]] const_iterator end() const noexcept { return { this, size() }; }
+
+		/// All fields, back to back
+		[[nodiscard]] string_view bytes() const noexcept { return { m_bytes.data(), m_bytes.size() }; }
+		/// For transforms that keep every byte in place; anything that changes field sizes has to go through the column
+		[[nodiscard]] std::span<char> mutable_bytes() noexcept { return m_bytes; }
+		/// Field `i` is `bytes().substr(offsets()[i], offsets()[i + 1] - offsets()[i])`
+		[[nodiscard]] std::span<const OFFSET> offsets() const noexcept { return m_offsets; }
+
+		/// Heap bytes held by the column, including unused capacity
+		[[nodiscard]] size_t memory_usage() const noexcept { return m_bytes.capacity() + m_offsets.capacity() * sizeof(OFFSET); }
+
+		void reserve(size_t fields, size_t bytes)
+		{
+			m_offsets.reserve(fields + 1);
+			m_bytes.reserve(bytes);
+		}
+
+		void push_back(string_view field)
+		{
+			m_bytes.insert(m_bytes.end(), field.begin(), field.end());
+			close_field();
+		}
+
+		void pop_back() noexcept
+		{
+			m_offsets.pop_back();
+			m_bytes.resize(m_offsets.back());
+		}
+
+		/// Keeps the capacity, so a reused column stops allocating once it has grown to its working size
+		void clear() noexcept
+		{
+			m_offsets.resize(1);
+			m_bytes.clear();
+		}
+
+		[[nodiscard]] allocator_type get_allocator() const noexcept { return allocator_type(m_bytes.get_allocator()); }
+
+		/// Runs `func(begin, end)` over contiguous index ranges covering the whole column, one per hardware thread, but only
+		/// if each range gets at least `min_fields_per_thread` fields; otherwise everything runs on the calling thread
+		template <typename FUNC>
+		requires std::invocable<FUNC&, size_t, size_t>
+		void parallel_for_ranges(FUNC&& func, size_t min_fields_per_thread = 16384) const
+		{
+			detail::parallel_for_chunks(size(), min_fields_per_thread, func);
+		}
+
+	private:
+
+		template <std::unsigned_integral O, typename A>
+		friend void trim_all(basic_string_column<O, A>& column) noexcept;
+		template <std::unsigned_integral O, typename A>
+		friend string_view consume_c_string(string_view& strv, basic_string_column<O, A>& out);
+
+		/// Turns the bytes appended since the last field into a new field
+		void close_field()
+		{
+			if constexpr (sizeof(OFFSET) < sizeof(size_t))
+			{
+				if (m_bytes.size() > std::numeric_limits<OFFSET>::max())
+				{
+					m_bytes.resize(m_offsets.back());
+					throw std::length_error("string column too large for its offset type");
+				}
+			}
+			m_offsets.push_back(OFFSET(m_bytes.size()));
+		}
+
+		std::vector<char, detail::rebind_alloc<ALLOC, char>> m_bytes;
+		std::vector<OFFSET, detail::rebind_alloc<ALLOC, OFFSET>> m_offsets;
+	};
+
+	using string_column = basic_string_column<uint32_t>;
+	using large_string_column = basic_string_column<uint64_t>;
+
+	template <typename DELIM, std::unsigned_integral OFFSET, typename ALLOC>
+	inline void split(string_view source, DELIM&& delim, basic_string_column<OFFSET, ALLOC>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(split, source.size());
+		::ghassanpl::string_ops::split(source, std::forward<DELIM>(delim), [&](string_view str, bool) { out.push_back(str); });
+	}
+
+	template <typename DELIM, std::unsigned_integral OFFSET, typename ALLOC>
+	inline void natural_split(string_view source, DELIM&& delim, basic_string_column<OFFSET, ALLOC>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(natural_split, source.size());
+		::ghassanpl::string_ops::natural_split(source, std::forward<DELIM>(delim), [&](string_view str, bool) { out.push_back(str); });
+	}
+
+	namespace detail
+	{
+		/// Lets `consume_c_string_into` decode straight into a byte vector
+		template <typename BYTES>
+		struct byte_appender
+		{
+			BYTES& bytes;
+			void push_back(char c) { bytes.push_back(c); }
+		};
+
+		template <typename BYTES>
+		inline size_t append_utf8(byte_appender<BYTES>& out, char32_t cp)
+		{
+			char bytes[4];
+			const auto length = encode_utf8(cp, bytes);
+			out.bytes.insert(out.bytes.end(), bytes, bytes + length);
+			return length;
+		}
+
+		/// Flips the case of every ASCII letter in `[from, to]`
+		inline void flip_ascii_case_in_range(char* begin, char* end, char from, char to) noexcept
+		{
+#if GHASSANPL_STRING_OPS_SSE2
+			const __m128i below = _mm_set1_epi8(char(from - 1));
+			const __m128i above = _mm_set1_epi8(char(to + 1));
+			const __m128i case_bit = _mm_set1_epi8(0x20);
+			for (; end - begin >= 16; begin += 16)
+			{
+				const __m128i v = _mm_loadu_si128((const __m128i*)begin);
+				/// Signed compares are fine, bytes >= 0x80 are negative and never in range
+				const __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+				_mm_storeu_si128((__m128i*)begin, _mm_xor_si128(v, _mm_and_si128(in_range, case_bit)));
+			}
+#endif
+			for (; begin != end; ++begin)
+			{
+				if (*begin >= from && *begin <= to)
+					*begin ^= 0x20;
+			}
+		}
+
+		inline void flip_ascii_case_in_range_parallel(std::span<char> bytes, char from, char to)
+		{
+			static constexpr size_t min_bytes_per_thread = size_t{ 1 } << 20;
+			parallel_for_chunks(bytes.size(), min_bytes_per_thread, [&](size_t begin, size_t end) {
+				flip_ascii_case_in_range(bytes.data() + begin, bytes.data() + end, from, to);
+			});
+		}
+	}
+
+	/// Appends the decoded contents of the literal to `out` as a new field (nothing on failure) and returns the literal itself, or an empty view if it is malformed
+	template <std::unsigned_integral OFFSET, typename ALLOC>
+	inline string_view consume_c_string(string_view& strv, basic_string_column<OFFSET, ALLOC>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(consume_c_string, 0);
+		detail::byte_appender<decltype(out.m_bytes)> appender{ out.m_bytes };
+		const auto literal = detail::consume_c_string_into(strv, appender);
+		GHASSANPL_STRING_OPS_STATS_BYTES(literal.size());
+		if (literal.empty())
+			out.m_bytes.resize(out.m_offsets.back());
+		else
+			out.close_field();
+		return literal;
+	}
+
+	/// Trims every field in place, compacting the bytes in a single pass
+	template <std::unsigned_integral OFFSET, typename ALLOC>
+	inline void trim_all(basic_string_column<OFFSET, ALLOC>& column) noexcept
+	{
+		const auto data = column.m_bytes.data();
+		OFFSET written = 0;
+		OFFSET begin = 0;
+		for (size_t i = 1; i < column.m_offsets.size(); ++i)
+		{
+			const OFFSET end = column.m_offsets[i];
+			const auto field_end = detail::skip_whitespace_backwards(data + begin, data + end);
+			const auto field_begin = detail::skip_whitespace(data + begin, field_end);
+			std::memmove(data + written, field_begin, size_t(field_end - field_begin));
+			written += OFFSET(field_end - field_begin);
+			column.m_offsets[i] = written;
+			begin = end;
+		}
+		column.m_bytes.resize(written);
+	}
+
+	namespace ascii
+	{
+		/// Lowercases every field in place, in parallel for large columns
+		template <std::unsigned_integral OFFSET, typename ALLOC>
+		inline void tolower(basic_string_column<OFFSET, ALLOC>& column)
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(tolower, column.bytes().size());
+			detail::flip_ascii_case_in_range_parallel(column.mutable_bytes(), 'A', 'Z');
+		}
+
+		/// Uppercases every field in place, in parallel for large columns
+		template <std::unsigned_integral OFFSET, typename ALLOC>
+		inline void toupper(basic_string_column<OFFSET, ALLOC>& column)
+		{
+			GHASSANPL_STRING_OPS_STATS_SCOPE(toupper, column.bytes().size());
+			detail::flip_ascii_case_in_range_parallel(column.mutable_bytes(), 'a', 'z');
+		}
+	}
+
+	/// Parses every field as a whole integer (no surrounding whitespace, no trailing characters) into `out[i]`, which must have room for `column.size()` values.
+	/// Fields that do not parse, or overflow `T`, get `T{}`. Runs in parallel for large columns. Returns the number of fields that parsed.
+	template <std::integral T, std::unsigned_integral OFFSET, typename ALLOC>
+	inline size_t parse_integers(basic_string_column<OFFSET, ALLOC> const& column, std::span<T> out, int base = 10)
+	{
+		std::atomic<size_t> parsed{ 0 };
+		column.parallel_for_ranges([&](size_t begin, size_t end) {
+			size_t count = 0;
+			for (size_t i = begin; i < end; ++i)
+			{
+				const auto field = column[i];
+				const auto result = std::from_chars(field.data(), field.data() + field.size(), out[i], base);
+				const bool ok = !field.empty() && result.ec == std::errc{} && result.ptr == field.data() + field.size();
+				if (!ok)
+					out[i] = T{};
+				count += ok;
+			}
+			parsed.fetch_add(count, std::memory_order_relaxed);
+		});
+		return parsed.load(std::memory_order_relaxed);
+	}
+
+	/// ///////////////////////////// ///
+	/// Small strings
+	/// ///////////////////////////// ///
+
+	namespace detail
+	{
+		/// A fixed-size hash for fixed-size buffers: whole words, no length-dependent branches
+		template <size_t SIZE>
+		[[nodiscard]] inline size_t hash_block(const char* bytes) noexcept
+		{
+			const auto mix = [](uint64_t hash, uint64_t word) {
+				hash = (hash ^ word) * 0xbf58476d1ce4e5b9ull;
+				return hash ^ (hash >> 31);
+			};
+			uint64_t hash = SIZE * 0x9e3779b97f4a7c15ull;
+			for (size_t i = 0; i + 8 <= SIZE; i += 8)
+			{
+				uint64_t word;
+				std::memcpy(&word, bytes + i, 8);
+				hash = mix(hash, word);
+			}
+			if constexpr (SIZE % 8 != 0)
+			{
+				uint64_t word = 0;
+				std::memcpy(&word, bytes + SIZE - SIZE % 8, SIZE % 8);
+				hash = mix(hash, word);
+			}
+			return size_t(hash ^ (hash >> 29));
+		}
+	}
+
+	/// A string of up to `N` bytes (at most 255) stored entirely inside the object, so `sizeof(inline_string<N>) == N + 1` and `inline_string<23>` is 24 bytes.
+	/// The last byte holds `N - size()`, which doubles as the null terminator when the string is full. Unused bytes are kept zeroed, so equality and hashing
+	/// work on the whole buffer at once. Going over the capacity throws `std::length_error`. Trivially copyable, and so trivially relocatable.
+	template <size_t N>
+	class inline_string
+	{
+		static_assert(N > 0 && N < 256, "inline_string capacity must be between 1 and 255");
+
+	public:
+
+		using value_type = char;
+		using size_type = size_t;
+		using iterator = char*;
+		using const_iterator = const char*;
+
+		inline_string() noexcept { m_chars[N] = char(N); }
+		explicit inline_string(string_view str) : inline_string() { assign(str); }
+
+		inline_string& operator=(string_view str) { return assign(str); }
+
+		inline_string& assign(string_view str)
+		{
+			if (str.size() > N)
+				throw std::length_error("string too long for inline_string");
+			std::char_traits<char>::move(m_chars, str.data(), str.size());
+			set_size(str.size());
+			return *this;
+		}
+
+		inline_string& append(string_view str)
+		{
+			const auto old_size = size();
+			if (str.size() > N - old_size)
+				throw std::length_error("string too long for inline_string");
+			std::char_traits<char>::move(m_chars + old_size, str.data(), str.size());
+			m_chars[N] = char(N - old_size - str.size());
+			return *this;
+		}
+
+		void push_back(char c) { append({ &c, 1 }); }
+		void pop_back() noexcept { set_size(size() - 1); }
+
+		/// New bytes are zero
+		void resize(size_t size)
+		{
+			if (size > N)
+				throw std::length_error("string too long for inline_string");
+			set_size(std::min(size, this->size()));
+			m_chars[N] = char(N - size);
+		}
+
+		void clear() noexcept { set_size(0); }
+
+		[[nodiscard]] size_t size() const noexcept { return N - uint8_t(m_chars[N]); }
+		[[nodiscard]] static constexpr size_t capacity() noexcept { return N; }
+		[[nodiscard]] static constexpr size_t max_size() noexcept { return N; }
+		[[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+		[[nodiscard]] char* data() noexcept { return m_chars; }
+		[[nodiscard]] const char* data() const noexcept { return m_chars; }
+		[[nodiscard]] const char* c_str() const noexcept { return m_chars; }
+		[[nodiscard]] char* begin() noexcept { return m_chars; }
+		[[nodiscard]] char* end() noexcept { return m_chars + size(); }
+		[[nodiscard]] const char* begin() const noexcept { return m_chars; }
+		[[nodiscard]] const char* end() const noexcept { return m_chars + size(); }
+		[[nodiscard]] char& operator[](size_t index) noexcept { return m_chars[index]; }
+		[[nodiscard]] char operator[](size_t index) const noexcept { return m_chars[index]; }
+
+		[[nodiscard]] string_view view() const noexcept { return { m_chars, size() }; }
+		[[nodiscard]] operator string_view() const noexcept { return view(); }
+
+		/// Same as `compact_string::hash()` for the same contents, whatever `N` is
+		[[nodiscard]] size_t hash() const noexcept
+		{
+			if constexpr (N == 23)
+				return detail::hash_block<N + 1>(m_chars);
+			else
+			{
+				/// Rebuild the layout of an inline `compact_string`: contents, zero padding, and the unused capacity in the last byte
+				const auto size = this->size();
+				if (size > 23)
+					return std::hash<string_view>{}(view());
+				char block[24]{};
+				std::memcpy(block, m_chars, std::min<size_t>(N, 23));
+				block[23] = char(23 - size);
+				return detail::hash_block<sizeof(block)>(block);
+			}
+		}
+
+		[[nodiscard]] friend bool operator==(inline_string const& a, inline_string const& b) noexcept { return std::memcmp(a.m_chars, b.m_chars, N + 1) == 0; }
+		[[nodiscard]] friend bool operator==(inline_string const& a, string_view b) noexcept { return a.view() == b; }
+		[[nodiscard]] friend auto operator<=>(inline_string const& a, string_view b) noexcept { return a.view() <=> b; }
+
+	private:
+
+		void set_size(size_t size) noexcept
+		{
+			std::memset(m_chars + size, 0, N - size);
+			m_chars[N] = char(N - size);
+		}
+
+		char m_chars[N + 1]{};
+	};
+
+	/// A string that keeps up to 23 bytes inside its 24-byte object and moves to the heap beyond that, independently of the standard library's
+	/// small string optimization. It never points into itself, so it is trivially relocatable (and passed in registers where `[[clang::trivial_abi]]`
+	/// is available). Strings that are inline in both operands compare and hash as three machine words.
+	class GHASSANPL_STRING_OPS_TRIVIAL_ABI compact_string
+	{
+	public:
+
+		using value_type = char;
+		using size_type = size_t;
+		using iterator = char*;
+		using const_iterator = const char*;
+
+		static constexpr size_t inline_capacity = 23;
+
+		compact_string() noexcept { m_bytes[23] = char(inline_capacity); }
+		explicit compact_string(string_view str) : compact_string() { assign(str); }
+		compact_string(compact_string const& other) : compact_string() { assign(other.view()); }
+		compact_string(compact_string&& other) noexcept
+		{
+			std::memcpy(m_bytes, other.m_bytes, sizeof(m_bytes));
+			other.reset();
+		}
+		~compact_string() { release(); }
+
+		compact_string& operator=(compact_string const& other) { return assign(other.view()); }
+		compact_string& operator=(compact_string&& other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				std::memcpy(m_bytes, other.m_bytes, sizeof(m_bytes));
+				other.reset();
+			}
+			return *this;
+		}
+		compact_string& operator=(string_view str) { return assign(str); }
+
+		compact_string& assign(string_view str)
+		{
+			if (str.size() > capacity())
+				reallocate(str.size(), {});
+			std::char_traits<char>::move(data(), str.data(), str.size());
+			set_size(str.size());
+			return *this;
+		}
+
+		compact_string& append(string_view str)
+		{
+			const auto old_size = size();
+			if (str.size() > capacity() - old_size)
+			{
+				/// `str` may point into our own buffer, which `reallocate` keeps alive until the copy is done
+				reallocate(std::max(old_size + str.size(), capacity() * 2), str);
+			}
+			else
+				std::char_traits<char>::move(data() + old_size, str.data(), str.size());
+			set_size(old_size + str.size());
+			return *this;
+		}
+
+		void push_back(char c) { append({ &c, 1 }); }
+		void pop_back() noexcept { set_size(size() - 1); }
+
+		/// New bytes are zero
+		void resize(size_t size)
+		{
+			const auto old_size = this->size();
+			if (size > capacity())
+				reallocate(size, {});
+			if (size > old_size)
+				std::memset(data() + old_size, 0, size - old_size);
+			set_size(size);
+		}
+
+		void reserve(size_t capacity)
+		{
+			if (capacity > this->capacity())
+			{
+				const auto old_size = size();
+				reallocate(capacity, {});
+				set_size(old_size);
+			}
+		}
+
+		/// Keeps heap storage, if any
+		void clear() noexcept { set_size(0); }
+
+		[[nodiscard]] bool heap_allocated() const noexcept { return uint8_t(m_bytes[23]) == heap_tag; }
+		[[nodiscard]] size_t size() const noexcept { return heap_allocated() ? heap_size() : inline_capacity - uint8_t(m_bytes[23]); }
+		[[nodiscard]] size_t capacity() const noexcept { return heap_allocated() ? heap_capacity() : inline_capacity; }
+		[[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+		[[nodiscard]] char* data() noexcept { return heap_allocated() ? heap_data() : m_bytes; }
+		[[nodiscard]] const char* data() const noexcept { return heap_allocated() ? heap_data() : m_bytes; }
+		[[nodiscard]] const char* c_str() const noexcept { return data(); }
+		[[nodiscard]] char* begin() noexcept { return data(); }
+		[[nodiscard]] char* end() noexcept { return data() + size(); }
+		[[nodiscard]] const char* begin() const noexcept { return data(); }
+		[[nodiscard]] const char* end() const noexcept { return data() + size(); }
+		[[nodiscard]] char& operator[](size_t index) noexcept { return data()[index]; }
+		[[nodiscard]] char operator[](size_t index) const noexcept { return data()[index]; }
+
+		[[nodiscard]] string_view view() const noexcept { return { data(), size() }; }
+		[[nodiscard]] operator string_view() const noexcept { return view(); }
+
+		/// Same as `inline_string<N>::hash()` for the same contents
+		[[nodiscard]] size_t hash() const noexcept
+		{
+			if (!heap_allocated())
+				return detail::hash_block<sizeof(m_bytes)>(m_bytes);
+			const auto size = heap_size();
+			if (size > inline_capacity)
+				return std::hash<string_view>{}(view());
+			char block[sizeof(m_bytes)]{};
+			std::memcpy(block, heap_data(), size);
+			block[23] = char(inline_capacity - size);
+			return detail::hash_block<sizeof(m_bytes)>(block);
+		}
+
+		[[nodiscard]] friend bool operator==(compact_string const& a, compact_string const& b) noexcept
+		{
+			if (std::memcmp(a.m_bytes, b.m_bytes, sizeof(m_bytes)) == 0)
+				return true;
+			if (!a.heap_allocated() && !b.heap_allocated())
+				return false;
+			return a.view() == b.view();
+		}
+		[[nodiscard]] friend bool operator==(compact_string const& a, string_view b) noexcept { return a.view() == b; }
+		[[nodiscard]] friend auto operator<=>(compact_string const& a, string_view b) noexcept { return a.view() <=> b; }
+
+	private:
+
+		/// Inline: the characters, zero padding, and `23 - size()` in the last byte (so a full string ends with its own null terminator).
+		/// Heap: the pointer at byte 0, the size at byte 8, the capacity in bytes 16 to 22, and `heap_tag` in the last byte.
+		static constexpr uint8_t heap_tag = 0xFF;
+		static constexpr size_t size_offset = 8;
+		static constexpr size_t capacity_offset = 16;
+
+		[[nodiscard]] char* heap_data() const noexcept { char* result; std::memcpy(&result, m_bytes, sizeof(result)); return result; }
+		[[nodiscard]] size_t heap_size() const noexcept { size_t result; std::memcpy(&result, m_bytes + size_offset, sizeof(result)); return result; }
+		[[nodiscard]] size_t heap_capacity() const noexcept
+		{
+			uint64_t result = 0;
+			for (size_t i = 0; i < 7; ++i)
+				result |= uint64_t(uint8_t(m_bytes[capacity_offset + i])) << (i * 8);
+			return size_t(result);
+		}
+
+		void set_size(size_t size) noexcept
+		{
+			if (heap_allocated())
+			{
+				std::memcpy(m_bytes + size_offset, &size, sizeof(size));
+				heap_data()[size] = 0;
+			}
+			else
+			{
+				std::memset(m_bytes + size, 0, inline_capacity - size);
+				m_bytes[23] = char(inline_capacity - size);
+			}
+		}
+
+		/// Moves to a heap buffer of `capacity` bytes (plus the terminator), keeping the current contents followed by `append`;
+		/// the caller sets the size
+		void reallocate(size_t capacity, string_view append)
+		{
+			/// The capacity has to fit in 7 bytes
+			if (capacity >= (uint64_t(1) << 56) - 1)
+				throw std::length_error("string too long for compact_string");
+			const auto old_size = size();
+			const auto buffer = new char[capacity + 1];
+			std::memcpy(buffer, data(), old_size);
+			std::char_traits<char>::copy(buffer + old_size, append.data(), append.size());
+			release();
+
+			std::memset(m_bytes, 0, sizeof(m_bytes));
+			std::memcpy(m_bytes, &buffer, sizeof(buffer));
+			std::memcpy(m_bytes + size_offset, &old_size, sizeof(old_size));
+			for (size_t i = 0; i < 7; ++i)
+				m_bytes[capacity_offset + i] = char(uint64_t(capacity) >> (i * 8));
+			m_bytes[23] = char(heap_tag);
+		}
+
+		void release() noexcept
+		{
+			if (heap_allocated())
+				delete[] heap_data();
+		}
+
+		void reset() noexcept
+		{
+			std::memset(m_bytes, 0, sizeof(m_bytes));
+			m_bytes[23] = char(inline_capacity);
+		}
+
+		char m_bytes[24]{};
+	};
+
+	static_assert(sizeof(inline_string<23>) == 24 && std::is_trivially_copyable_v<inline_string<23>>);
+	static_assert(sizeof(compact_string) == 24);
+
+	namespace detail
+	{
+		template <typename T>
+		constexpr bool is_small_string = false;
+		template <size_t N>
+		constexpr bool is_small_string<inline_string<N>> = true;
+		template <>
+		constexpr bool is_small_string<compact_string> = true;
+
+		template <size_t N>
+		[[nodiscard]] constexpr bool heap_allocated(inline_string<N> const&) noexcept { return false; }
+		[[nodiscard]] inline bool heap_allocated(compact_string const& str) noexcept { return str.heap_allocated(); }
+
+		/// Lets `consume_c_string_into` decode into an `inline_string`, remembering instead of throwing when it runs out of room
+		template <size_t N>
+		struct bounded_appender
+		{
+			inline_string<N>& out;
+			bool overflow = false;
+
+			void push_back(char c)
+			{
+				if (out.size() == N)
+					overflow = true;
+				else
+					out.push_back(c);
+			}
+		};
+
+		template <size_t N>
+		inline size_t append_utf8(bounded_appender<N>& appender, char32_t cp)
+		{
+			char bytes[4];
+			const auto length = encode_utf8(cp, bytes);
+			if (length > N - appender.out.size())
+				appender.overflow = true;
+			else
+				appender.out.append({ bytes, length });
+			return length;
+		}
+	}
+
+	/// e.g. `make_string<compact_string>(begin, end)`
+	template <typename STRING, std::contiguous_iterator IT>
+	requires detail::is_small_string<STRING>
+	[[nodiscard]] inline STRING make_string(IT start, IT end)
+	{
+		const auto str = make_sv(static_cast<const char*>(std::to_address(start)), static_cast<const char*>(std::to_address(end)));
+		GHASSANPL_STRING_OPS_STATS_SCOPE(make_string, str.size());
+		STRING result{ str };
+		GHASSANPL_STRING_OPS_STATS_ALLOCATIONS(detail::heap_allocated(result));
+		return result;
+	}
+
+	namespace ascii
+	{
+		/// Versions that fill a small string (`out` is overwritten)
+		template <size_t N>
+		inline inline_string<N>& tolower(string_view str, inline_string<N>& out) { out.assign(str); detail::flip_ascii_case_in_range(out.begin(), out.end(), 'A', 'Z'); return out; }
+		template <size_t N>
+		inline inline_string<N>& toupper(string_view str, inline_string<N>& out) { out.assign(str); detail::flip_ascii_case_in_range(out.begin(), out.end(), 'a', 'z'); return out; }
+		inline compact_string& tolower(string_view str, compact_string& out) { out.assign(str); detail::flip_ascii_case_in_range(out.begin(), out.end(), 'A', 'Z'); return out; }
+		inline compact_string& toupper(string_view str, compact_string& out) { out.assign(str); detail::flip_ascii_case_in_range(out.begin(), out.end(), 'a', 'z'); return out; }
+	}
+
+	inline size_t append_utf8(compact_string& buffer, char32_t cp)
+	{
+		char bytes[4];
+		const auto length = detail::encode_utf8(cp, bytes);
+		buffer.append({ bytes, length });
+		return length;
+	}
+
+	/// Appends the decoded contents of the literal to `out` (nothing on failure) and returns the literal itself, or an empty view if it is malformed
+	inline string_view consume_c_string(string_view& strv, compact_string& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(consume_c_string, 0);
+		const auto previous_size = out.size();
+		const auto literal = detail::consume_c_string_into(strv, out);
+		GHASSANPL_STRING_OPS_STATS_BYTES(literal.size());
+		if (literal.empty())
+			out.resize(previous_size);
+		return literal;
+	}
+
+	/// Appends the decoded contents of the literal to `out` and returns the literal itself. If the literal is malformed or its contents
+	/// do not fit, returns an empty view and leaves both `strv` and `out` unmodified.
+	template <size_t N>
+	inline string_view consume_c_string(string_view& strv, inline_string<N>& out)
+	{
+		GHASSANPL_STRING_OPS_STATS_SCOPE(consume_c_string, 0);
+		const auto previous_size = out.size();
+		const auto source = strv;
+		detail::bounded_appender<N> appender{ out };
+		const auto literal = detail::consume_c_string_into(strv, appender);
+		GHASSANPL_STRING_OPS_STATS_BYTES(literal.size());
+		if (literal.empty() || appender.overflow)
+		{
+			out.resize(previous_size);
+			strv = source;
+			return {};
+		}
+		return literal;
+	}
+
+	/// ///////////////////////////// ///
+	/// Keyword sets
+	/// ///////////////////////////// ///
+
+	namespace detail
+	{
+		/// A bijection, so distinct keys never end up with the same hash
+		[[nodiscard]] constexpr uint64_t mix_keyword_key(uint64_t key) noexcept
+		{
+			key = (key ^ (key >> 32)) * 0xd6e8feb86659fd93ull;
+			return key ^ (key >> 32);
+		}
+	}
+
+	/// A fixed set of keywords with a perfect hash, built at compile time (see `make_keyword_set`).
+	/// The key of a string is its length plus up to 6 bytes sampled at positions counted from its start or end, chosen greedily at
+	/// build time until every keyword has a different key. Keys are then placed with hash-and-displace: each key's bucket stores
+	/// a displacement that moves all keys in the bucket into free slots of a table at most half full.
+	/// `lookup` thus costs a few byte loads, three multiplications, two table loads, and a single comparison with the candidate keyword.
+	/// With `IGNORE_CASE`, ASCII letters are folded both when sampling and in that final comparison.
+	/// Building a set of 500 keywords takes about a second of compile time with GCC.
+	template <size_t COUNT, bool IGNORE_CASE = false>
+	class keyword_set
+	{
+		static_assert(COUNT > 0 && COUNT < 0xFFFF, "keyword_set must have between 1 and 65534 keywords");
+
+	public:
+
+		static constexpr size_t max_sampled_bytes = 6;
+
+		/// Fails to compile if keywords are duplicates (ignoring case with `IGNORE_CASE`), are longer than 65535 bytes,
+		/// or cannot be told apart by their length and 6 sampled bytes
+		consteval explicit keyword_set(std::array<string_view, COUNT> const& keywords)
+			: m_keywords(keywords)
+		{
+			for (auto const& keyword : m_keywords)
+			{
+				if (keyword.size() > 0xFFFF)
+					throw "keyword too long";
+			}
+			choose_samples();
+			place_keys();
+			collect_lengths();
+		}
+
+		/// The index of `str` in the set, or `string_view::npos`
+		[[nodiscard]] constexpr size_t lookup(string_view str) const noexcept
+		{
+			const auto index = m_slots[slot_of(hash_of(str))];
+			if (index == empty_slot || !equal(m_keywords[index], str))
+				return string_view::npos;
+			return index;
+		}
+
+		[[nodiscard]] constexpr bool contains(string_view str) const noexcept { return lookup(str) != string_view::npos; }
+
+		/// The index of the longest keyword that `str` starts with, or `string_view::npos`.
+		/// Does one `lookup` per distinct keyword length that fits in `str`.
+		[[nodiscard]] constexpr size_t find_prefix(string_view str) const noexcept
+		{
+			for (size_t i = 0; i < m_length_count; ++i)
+			{
+				if (m_lengths[i] > str.size())
+					continue;
+				if (const auto index = lookup(str.substr(0, m_lengths[i])); index != string_view::npos)
+					return index;
+			}
+			return string_view::npos;
+		}
+
+		[[nodiscard]] static constexpr size_t size() noexcept { return COUNT; }
+		[[nodiscard]] static constexpr bool ignores_case() noexcept { return IGNORE_CASE; }
+		[[nodiscard]] constexpr string_view operator[](size_t index) const noexcept { return m_keywords[index]; }
+		[[nodiscard]] constexpr std::span<const string_view, COUNT> keywords() const noexcept { return m_keywords; }
+		/// How many bytes the hash samples besides the length
+		[[nodiscard]] constexpr size_t sampled_bytes() const noexcept { return m_sample_count; }
+
+	private:
+
+		static constexpr size_t slot_count = std::bit_ceil(COUNT) * 2;
+		static constexpr size_t bucket_count = std::max<size_t>(std::bit_ceil(COUNT) / 2, 1);
+		static constexpr int slot_shift = 64 - std::countr_zero(slot_count);
+		static constexpr uint16_t empty_slot = 0xFFFF;
+
+		[[nodiscard]] static constexpr bool equal(string_view keyword, string_view str) noexcept
+		{
+			if constexpr (IGNORE_CASE)
+			{
+				if (keyword.size() != str.size())
+					return false;
+				for (size_t i = 0; i < str.size(); ++i)
+				{
+					/// A difference in bit 5 alone is a difference in case, if the bytes are letters
+					const auto a = uint8_t(keyword[i]), difference = uint8_t(a ^ uint8_t(str[i]));
+					if (difference != 0 && (difference != 0x20 || !ascii::isalpha(a)))
+						return false;
+				}
+				return true;
+			}
+			else
+				return keyword == str;
+		}
+
+		/// Negative positions count from the end; either way, positions outside the string sample a zero
+		[[nodiscard]] static constexpr uint64_t sample(string_view str, int8_t position) noexcept
+		{
+			const auto index = position >= 0 ? size_t(position) : str.size() + size_t(ptrdiff_t(position));
+			auto byte = index < str.size() ? uint8_t(str[index]) : uint8_t(0);
+			if constexpr (IGNORE_CASE)
+				byte = uint8_t(ascii::tolower(char32_t(byte)));
+			return byte;
+		}
+
+		/// The length in the top 16 bits and the sampled bytes below, which is injective for keywords
+		[[nodiscard]] static constexpr uint64_t length_key(string_view str) noexcept { return uint64_t(std::min<size_t>(str.size(), 0xFFFF)) << 48; }
+
+		[[nodiscard]] constexpr uint64_t hash_of(string_view str) const noexcept
+		{
+			uint64_t key = length_key(str);
+			for (size_t i = 0; i < m_sample_count; ++i)
+				key |= sample(str, m_samples[i]) << (i * 8);
+			return detail::mix_keyword_key(key);
+		}
+
+		[[nodiscard]] static constexpr size_t bucket_of(uint64_t hash) noexcept { return size_t(hash >> 40) & (bucket_count - 1); }
+		[[nodiscard]] static constexpr size_t slot_of(uint64_t hash, uint16_t displacement) noexcept
+		{
+			return size_t(((hash ^ (displacement * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull) >> slot_shift);
+		}
+		[[nodiscard]] constexpr size_t slot_of(uint64_t hash) const noexcept { return slot_of(hash, m_displacements[bucket_of(hash)]); }
+
+		static constexpr size_t candidate_positions = 32;
+		[[nodiscard]] static constexpr int8_t candidate_position(size_t candidate) noexcept { return int8_t(candidate % 2 == 0 ? int(candidate / 2) : -int(candidate / 2) - 1); }
+
+		/// Counts distinct keys with open addressing; bumping `round` clears it without rewriting it.
+		/// This runs at compile time over hundreds of keywords, so the loops stick to plain arrays and avoid calls.
+		struct key_counter
+		{
+			uint64_t keys[slot_count]{};
+			uint16_t counts[slot_count]{};
+			uint32_t rounds[slot_count]{};
+			uint32_t round = 0;
+
+			[[nodiscard]] constexpr size_t home_slot(uint64_t key) const noexcept
+			{
+				const uint64_t hash = (key ^ (key >> 32)) * 0xd6e8feb86659fd93ull;
+				return size_t((hash ^ (hash >> 32)) >> slot_shift);
+			}
+
+			/// Counts the keys of the `count` keywords in `indices`, each with `byte_at[index * stride]` shifted by `shift` added (if `byte_at` is not null)
+			constexpr size_t count(uint64_t const* keys_of, uint16_t const* indices, size_t count, uint8_t const* byte_at, size_t stride, size_t shift) noexcept
+			{
+				++round;
+				size_t distinct = 0;
+				for (size_t a = 0; a < count; ++a)
+				{
+					const size_t i = indices[a];
+					const uint64_t key = byte_at ? keys_of[i] | (uint64_t(byte_at[i * stride]) << shift) : keys_of[i];
+					const uint64_t hash = (key ^ (key >> 32)) * 0xd6e8feb86659fd93ull;
+					size_t slot = size_t((hash ^ (hash >> 32)) >> slot_shift);
+					while (rounds[slot] == round && keys[slot] != key)
+						slot = (slot + 1) & (slot_count - 1);
+					if (rounds[slot] != round)
+					{
+						rounds[slot] = round;
+						keys[slot] = key;
+						counts[slot] = 0;
+						++distinct;
+					}
+					++counts[slot];
+				}
+				return distinct;
+			}
+
+			/// How many of the keys in the last `count` equal `key`
+			[[nodiscard]] constexpr size_t count_of(uint64_t key) const noexcept
+			{
+				size_t slot = home_slot(key);
+				while (keys[slot] != key)
+					slot = (slot + 1) & (slot_count - 1);
+				return counts[slot];
+			}
+		};
+
+		/// Greedily adds the sample position that separates the most keywords, trying positions near either end first.
+		/// Keys that are already unique stay unique as bytes are added, so each round only looks at the keywords that still share a key.
+		constexpr void choose_samples()
+		{
+			uint8_t bytes[COUNT * candidate_positions]{};
+			uint64_t keys[COUNT]{};
+			uint16_t ambiguous[COUNT]{};
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				const auto data = m_keywords[i].data();
+				const auto size = m_keywords[i].size();
+				for (size_t c = 0; c < candidate_positions; ++c)
+				{
+					/// Same as `sample(m_keywords[i], candidate_position(c))`
+					const size_t index = c % 2 == 0 ? c / 2 : size - c / 2 - 1;
+					auto byte = index < size ? uint8_t(data[index]) : uint8_t(0);
+					if (IGNORE_CASE && byte >= 'A' && byte <= 'Z')
+						byte |= 0x20;
+					bytes[i * candidate_positions + c] = byte;
+				}
+				keys[i] = length_key(m_keywords[i]);
+				ambiguous[i] = uint16_t(i);
+			}
+
+			key_counter counter;
+			bool chosen[candidate_positions]{};
+			size_t ambiguous_count = COUNT;
+			while (true)
+			{
+				counter.count(keys, ambiguous, ambiguous_count, nullptr, 0, 0);
+				size_t kept = 0;
+				for (size_t a = 0; a < ambiguous_count; ++a)
+				{
+					if (counter.count_of(keys[ambiguous[a]]) > 1)
+						ambiguous[kept++] = ambiguous[a];
+				}
+				ambiguous_count = kept;
+				if (ambiguous_count == 0)
+					return;
+				if (m_sample_count == max_sampled_bytes)
+					throw "keywords are duplicates or cannot be told apart by their length and 6 sampled bytes";
+
+				const size_t shift = m_sample_count * 8;
+				size_t best_candidate = 0;
+				size_t best_distinct = 0;
+				for (size_t c = 0; c < candidate_positions; ++c)
+				{
+					if (chosen[c])
+						continue;
+					if (const auto distinct = counter.count(keys, ambiguous, ambiguous_count, bytes + c, candidate_positions, shift); distinct > best_distinct)
+					{
+						best_distinct = distinct;
+						best_candidate = c;
+					}
+				}
+
+				for (size_t a = 0; a < ambiguous_count; ++a)
+					keys[ambiguous[a]] |= uint64_t(bytes[ambiguous[a] * candidate_positions + best_candidate]) << shift;
+				chosen[best_candidate] = true;
+				m_samples[m_sample_count++] = candidate_position(best_candidate);
+			}
+		}
+
+		/// Places the largest buckets first, trying displacements until all of a bucket's keys land in distinct free slots
+		constexpr void place_keys()
+		{
+			std::array<uint64_t, COUNT> hashes{};
+			std::array<uint16_t, bucket_count + 1> bucket_start{};
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				hashes[i] = hash_of(m_keywords[i]);
+				++bucket_start[bucket_of(hashes[i]) + 1];
+			}
+
+			size_t largest_bucket = 0;
+			for (size_t b = 0; b < bucket_count; ++b)
+			{
+				largest_bucket = std::max<size_t>(largest_bucket, bucket_start[b + 1]);
+				bucket_start[b + 1] += bucket_start[b];
+			}
+
+			std::array<uint16_t, COUNT> members{};
+			std::array<uint16_t, bucket_count> filled{};
+			for (size_t i = 0; i < COUNT; ++i)
+			{
+				const auto bucket = bucket_of(hashes[i]);
+				members[bucket_start[bucket] + filled[bucket]++] = uint16_t(i);
+			}
+
+			m_slots.fill(empty_slot);
+			std::array<size_t, COUNT> slots{};
+			for (size_t size = largest_bucket; size > 0; --size)
+			{
+				for (size_t b = 0; b < bucket_count; ++b)
+				{
+					if (size_t(bucket_start[b + 1] - bucket_start[b]) != size)
+						continue;
+
+					const auto first = members.begin() + bucket_start[b];
+					size_t displacement = 0;
+					for (; displacement <= 0xFFFF; ++displacement)
+					{
+						bool fits = true;
+						for (size_t k = 0; k < size && fits; ++k)
+						{
+							slots[k] = slot_of(hashes[first[k]], uint16_t(displacement));
+							fits = m_slots[slots[k]] == empty_slot && std::find(slots.begin(), slots.begin() + k, slots[k]) == slots.begin() + k;
+						}
+						if (fits)
+							break;
+					}
+					if (displacement > 0xFFFF)
+						throw "could not find a perfect hash for these keywords";
+
+					m_displacements[b] = uint16_t(displacement);
+					for (size_t k = 0; k < size; ++k)
+						m_slots[slots[k]] = first[k];
+				}
+			}
+		}
+
+		/// Distinct keyword lengths, longest first, for `find_prefix`
+		constexpr void collect_lengths()
+		{
+			for (auto const& keyword : m_keywords)
+			{
+				const auto length = uint16_t(keyword.size());
+				if (std::find(m_lengths.begin(), m_lengths.begin() + m_length_count, length) == m_lengths.begin() + m_length_count)
+					m_lengths[m_length_count++] = length;
+			}
+			std::sort(m_lengths.begin(), m_lengths.begin() + m_length_count, std::greater<>{});
+		}
+
+		std::array<string_view, COUNT> m_keywords;
+		std::array<int8_t, max_sampled_bytes> m_samples{};
+		size_t m_sample_count = 0;
+		std::array<uint16_t, bucket_count> m_displacements{};
+		std::array<uint16_t, slot_count> m_slots{};
+		std::array<uint16_t, COUNT> m_lengths{};
+		size_t m_length_count = 0;
+	};
+
+	/// e.g. `constexpr auto keywords = make_keyword_set("if", "else", "while");`
+	template <typename... KEYWORDS>
+	[[nodiscard]] consteval auto make_keyword_set(KEYWORDS const&... keywords)
+	{
+		return keyword_set<sizeof...(KEYWORDS)>({ string_view{ keywords }... });
+	}
+
+	/// Matches keywords regardless of the case of ASCII letters
+	template <typename... KEYWORDS>
+	[[nodiscard]] consteval auto make_keyword_set_ignore_case(KEYWORDS const&... keywords)
+	{
+		return keyword_set<sizeof...(KEYWORDS), true>({ string_view{ keywords }... });
+	}
+
+	/// If `str` starts with a keyword from `set` (the longest one, if several do), consumes it and returns its index; otherwise returns `string_view::npos`
+	template <size_t COUNT, bool IGNORE_CASE>
+	constexpr size_t consume_one_of(string_view& str, keyword_set<COUNT, IGNORE_CASE> const& set) noexcept
+	{
+		const auto index = set.find_prefix(str);
+		if (index != string_view::npos)
+			str.remove_prefix(set[index].size());
+		return index;
+	}
+
+}
+
+template <size_t N>
+struct std::hash<ghassanpl::string_ops::inline_string<N>>
+{
+	[[nodiscard]] size_t operator()(ghassanpl::string_ops::inline_string<N> const& str) const noexcept { return str.hash(); }
+};
+
+template <>
+struct std::hash<ghassanpl::string_ops::compact_string>
+{
+	[[nodiscard]] size_t operator()(ghassanpl::string_ops::compact_string const& str) const noexcept { return str.hash(); }
+};
@@ -7,9 +7,36 @@
 #define FMT_HEADER_ONLY 1
 #include "../include/string_ops2.h"
 #include <gtest/gtest.h>
+#include <memory_resource>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <unordered_set>
 
 using namespace ghassanpl::string_ops;
 
+/// Counts global allocations so tests can check that allocator-aware paths never reach the global heap
+static std::atomic<size_t> global_allocations = 0;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" /// false positive for replaced operator new/delete
+#endif
+
+void* operator new(std::size_t size)
+{
+  ++global_allocations;
+  if (auto ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc{};
+}
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+  ++global_allocations;
+  return std::malloc(size ? size : 1);
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
 TEST(isalpha, works_for_all_ascii)
 {
   
@@ -30,6 +57,896 @@ TEST(make_sv, fails_for_invalid_range)
   EXPECT_EQ(make_sv(hello.end(), hello.begin()), "");
 }
 
+TEST(hex, round_trips_all_byte_values)
+{
+  std::string bytes;
+  for (int i = 0; i < 256 * 3 + 7; ++i)
+    bytes += char(i * 37 + 11);
+
+  const auto hex = hex_encode(bytes);
+  ASSERT_EQ(hex.size(), hex_encoded_size(bytes.size()));
+  EXPECT_EQ(hex_encode("\x01\xAB\xff"), "01ABFF");
+
+  std::string decoded(hex_decoded_size(hex.size()), '\0');
+  const auto result = hex_decode(hex, decoded.data());
+  EXPECT_TRUE(result);
+  EXPECT_EQ(result.out, decoded.data() + decoded.size());
+  EXPECT_EQ(decoded, bytes);
+
+  char lower[3];
+  EXPECT_TRUE(hex_decode("01abfF", lower));
+  EXPECT_EQ(string_view(lower, 3), "\x01\xAB\xff");
+}
+
+TEST(hex, reports_first_invalid_position)
+{
+  char out[64];
+  for (size_t i = 0; i < 40; ++i)
+  {
+    std::string hex(40, 'a');
+    hex[i] = 'g';
+    EXPECT_EQ(hex_decode(hex, out).error_at, i);
+  }
+  EXPECT_EQ(hex_decode("abc", out).error_at, 3);
+  EXPECT_EQ(hex_decode("abz", out).error_at, 2);
+}
+
+TEST(base64, matches_rfc4648_vectors)
+{
+  const std::pair<string_view, string_view> vectors[] = {
+    { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+    { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" },
+  };
+  for (auto [plain, encoded] : vectors)
+  {
+    EXPECT_EQ(base64_encode(plain), encoded);
+    std::string decoded(base64_decoded_size(encoded), '\0');
+    EXPECT_TRUE(base64_decode(encoded, decoded.data()));
+    EXPECT_EQ(decoded, plain);
+  }
+  EXPECT_EQ(base64_encode("fo", base64_alphabet::url_safe, false), "Zm8");
+  EXPECT_EQ(base64_encode("\xfb\xff", base64_alphabet::url_safe), "-_8=");
+}
+
+TEST(base64, round_trips_both_alphabets)
+{
+  std::string bytes;
+  for (int i = 0; i < 1000; ++i)
+    bytes += char(i * 131 + 7);
+
+  for (auto alphabet : { base64_alphabet::standard, base64_alphabet::url_safe })
+  {
+    for (size_t len : { size_t(0), size_t(1), size_t(2), size_t(15), size_t(16), size_t(47), size_t(1000) })
+    {
+      const auto input = string_view(bytes).substr(0, len);
+      for (bool pad : { true, false })
+      {
+        const auto encoded = base64_encode(input, alphabet, pad);
+        ASSERT_EQ(encoded.size(), base64_encoded_size(len, pad));
+        std::string decoded(base64_decoded_size(encoded), '\0');
+        const auto result = base64_decode(encoded, decoded.data(), alphabet);
+        ASSERT_TRUE(result);
+        EXPECT_EQ(result.out, decoded.data() + decoded.size());
+        EXPECT_EQ(decoded, input);
+      }
+    }
+  }
+}
+
+TEST(base64, reports_first_invalid_position)
+{
+  std::string out(100, '\0');
+  for (size_t i = 0; i < 64; ++i)
+  {
+    std::string encoded(64, 'Q');
+    encoded[i] = '*';
+    EXPECT_EQ(base64_decode(encoded, out.data()).error_at, i);
+    encoded[i] = '-';
+    EXPECT_EQ(base64_decode(encoded, out.data()).error_at, i);
+    EXPECT_TRUE(base64_decode(encoded, out.data(), base64_alphabet::url_safe));
+  }
+  EXPECT_EQ(base64_decode("Zm9vY", out.data()).error_at, 5);
+  EXPECT_EQ(base64_decode("Zm9=Yg==", out.data()).error_at, 3);
+  EXPECT_EQ(base64_decode("Zm8==", out.data()).error_at, 3);
+}
+
+TEST(string_builder, stays_inline_for_small_output)
+{
+  basic_string_builder<64> builder;
+  builder << "x = " << 42 << ", y = " << -7 << ' ';
+  builder.append_utf8(U'\u00e9');
+  builder.append_utf8(U'\U0001F600');
+  builder.append_float(0.5);
+  EXPECT_EQ(builder.str(), "x = 42, y = -7 \xc3\xa9\xf0\x9f\x98\x80" "0.5");
+  EXPECT_EQ(builder.view(), builder.str());
+  EXPECT_GT(builder.available(), 0u);
+}
+
+TEST(string_builder, grows_across_blocks_without_losing_content)
+{
+  basic_string_builder<8> builder;
+  std::string expected;
+  for (int i = 0; i < 1000; ++i)
+  {
+    builder.append_integer(i, 16).append(',');
+    char buf[16];
+    expected.append(buf, std::to_chars(buf, buf + 16, i, 16).ptr);
+    expected += ',';
+  }
+  builder.append(300, '-');
+  expected.append(300, '-');
+  EXPECT_EQ(builder.size(), expected.size());
+  EXPECT_EQ(builder.str(), expected);
+
+  builder.truncate(5);
+  EXPECT_EQ(builder.str(), expected.substr(0, 5));
+  builder.append(expected.substr(5));
+  EXPECT_EQ(builder.view(), expected);
+
+  builder.clear();
+  EXPECT_TRUE(builder.empty());
+  builder.reserve_exact(1000);
+  EXPECT_GE(builder.available(), 1000u);
+}
+
+TEST(string_builder, is_a_target_for_output_functions)
+{
+  string_builder builder;
+  std::vector<string_view> words = { "a", "b", "c" };
+  join(words, ", ", builder) << "; ";
+  join_and(words, ", ", " and ", builder) << "; ";
+  join(std::vector<int>{ 1, 2, 3 }, '+', [](int i) { return i * 2; }, builder);
+  EXPECT_EQ(builder.str(), "a, b, c; a, b and c; 2+4+6");
+  EXPECT_EQ(join(words, "-"), "a-b-c");
+
+  builder.clear();
+  string_view source = R"("tab\there" rest)";
+  EXPECT_EQ(consume_c_string(source, builder), R"("tab\there")");
+  EXPECT_EQ(source, " rest");
+  EXPECT_EQ(builder.str(), "tab\there");
+
+  string_view malformed = R"("bad\q")";
+  EXPECT_TRUE(consume_c_string(malformed, builder).empty());
+  EXPECT_EQ(builder.str(), "tab\there");
+
+  for (const auto unterminated : { string_view{ "\"" }, string_view{ "\"abc" }, string_view{ R"("abc\")" }.substr(0, 5) })
+  {
+    auto view = unterminated;
+    EXPECT_TRUE(consume_c_string(view).first.empty()) << unterminated;
+    EXPECT_TRUE(consume_c_string(view, builder).empty()) << unterminated;
+    compact_string compact;
+    EXPECT_TRUE(consume_c_string(view, compact).empty()) << unterminated;
+    EXPECT_EQ(view, unterminated);
+  }
+}
+
+TEST(allocators, arena_overloads_make_no_global_allocations)
+{
+  alignas(std::max_align_t) char buffer[16384];
+  std::pmr::monotonic_buffer_resource arena{ buffer, sizeof(buffer), std::pmr::null_memory_resource() };
+  std::pmr::polymorphic_allocator<char> alloc{ &arena };
+
+  const auto before = global_allocations.load();
+
+  auto fields = split("alpha,beta,,gamma", ',', alloc);
+  auto words = natural_split("one  two   three", ' ', alloc);
+  auto lower = ascii::tolower("MiXeD CaSe, Long Enough To Not Fit In SSO", alloc);
+  auto upper = ascii::toupper(lower, alloc);
+  auto made = make_string(upper.data(), upper.data() + 5, alloc);
+  string_view source = R"("escaped \u00e9 string, long enough to not fit in SSO" tail)";
+  auto [literal, decoded] = consume_c_string(source, alloc);
+  std::pmr::string joined{ alloc };
+  join(fields, "; ", joined);
+  basic_string_builder<16, std::pmr::polymorphic_allocator<char>> builder{ alloc };
+  join_and(words, ", ", " and ", builder).append(' ').append_integer(1234567890);
+  auto built = builder.str(alloc);
+
+  const auto after = global_allocations.load();
+  EXPECT_EQ(after, before);
+
+  EXPECT_EQ(fields.size(), 4u);
+  EXPECT_EQ(words.size(), 3u);
+  EXPECT_EQ(lower, "mixed case, long enough to not fit in sso");
+  EXPECT_EQ(made, "MIXED");
+  EXPECT_EQ(decoded, "escaped \xc3\xa9 string, long enough to not fit in SSO");
+  EXPECT_EQ(source, " tail");
+  EXPECT_EQ(joined, "alpha; beta; ; gamma");
+  EXPECT_EQ(built, "one, two and three 1234567890");
+}
+
+TEST(allocators, output_parameters_reuse_capacity)
+{
+  std::vector<string_view> fields;
+  std::string text;
+  fields.reserve(16);
+  text.reserve(64);
+
+  const auto before = global_allocations.load();
+  for (int i = 0; i < 3; ++i)
+  {
+    fields.clear();
+    split("a,b,c", ',', fields);
+    natural_split("d  e", ' ', fields);
+    ascii::toupper("abc", text);
+    join(fields, '|', text);
+  }
+  EXPECT_EQ(global_allocations.load(), before);
+  EXPECT_EQ(text, "ABCa|b|c|d|e");
+}
+
+TEST(sort_key, orders_numbers_naturally)
+{
+  std::vector<std::string> names = { "file10.txt", "File2.txt", "file2.txt", "file1.txt", "file002.txt", "file", "a100b9", "a100b10", "a99" };
+  sort_by_key(std::span{ names }, collation::natural);
+  EXPECT_EQ(names, (std::vector<std::string>{ "File2.txt", "a99", "a100b9", "a100b10", "file", "file1.txt", "file2.txt", "file002.txt", "file10.txt" }));
+
+  sort_by_key(std::span{ names }, collation::natural_ignore_case);
+  EXPECT_EQ(names, (std::vector<std::string>{ "a99", "a100b9", "a100b10", "file", "file1.txt", "File2.txt", "file2.txt", "file002.txt", "file10.txt" }));
+
+  EXPECT_LT(make_sort_key("x9", collation::natural), make_sort_key("x10", collation::natural));
+  EXPECT_GT(make_sort_key("x9", collation::binary), make_sort_key("x10", collation::binary));
+  EXPECT_EQ(make_sort_key("x" + std::string(300, '7'), collation::natural).size(), sort_key_size("x" + std::string(300, '7'), collation::natural));
+  EXPECT_LT(make_sort_key("x" + std::string(254, '9'), collation::natural), make_sort_key("x1" + std::string(300, '0'), collation::natural));
+}
+
+TEST(sort_key, sort_by_key_matches_case_insensitive_comparison)
+{
+  std::vector<std::string> words;
+  uint32_t seed = 12345;
+  for (int i = 0; i < 100000; ++i)
+  {
+    std::string word;
+    for (int len = 1 + (seed >> 28); len > 0; --len)
+    {
+      seed = seed * 1664525 + 1013904223;
+      word += "abcXYZ_019"[(seed >> 16) % 10];
+    }
+    words.push_back(std::move(word));
+  }
+
+  std::vector<string_view> views(words.begin(), words.end());
+  sort_by_key(std::span{ views }, collation::ignore_case);
+  EXPECT_TRUE(std::is_sorted(views.begin(), views.end(), [](string_view a, string_view b) {
+    return ascii::lexicographical_compare_ignore_case(a, b);
+  }));
+}
+
+TEST(sort_strings, handles_shared_prefixes_and_embedded_nulls)
+{
+  using namespace std::string_view_literals;
+  std::vector<string_view> strings = {
+    "prefix_prefix_b"sv, "prefix_prefix_a"sv, ""sv, "prefix_prefix"sv, "ab\0"sv, "ab"sv, "\xff"sv,
+    "prefix_prefix_"sv, "b"sv, "a"sv, "prefix_p"sv, "prefix_prefix_a"sv, "prefix_"sv, "ab\0\0"sv,
+    "same_long_string_0123456789"sv, "same_long_string_0123456788"sv, "same_long_string_0123456789"sv,
+  };
+  auto expected = strings;
+  std::sort(expected.begin(), expected.end());
+  sort_strings(strings);
+  EXPECT_EQ(strings, expected);
+
+  const auto unique = unique_strings(strings);
+  EXPECT_EQ(unique.size(), expected.size() - 2);
+  EXPECT_TRUE(std::adjacent_find(unique.begin(), unique.end()) == unique.end());
+}
+
+TEST(sort_strings, matches_std_sort_on_large_inputs)
+{
+  std::string text;
+  uint32_t seed = 42;
+  for (int i = 0; i < 400000; ++i)
+  {
+    seed = seed * 1664525 + 1013904223;
+    text += "token_";
+    text += std::to_string(seed % 50000);
+    text += (seed >> 20) % 3 ? ' ' : ',';
+  }
+
+  auto tokens = split(text, " ,");
+  auto expected = tokens;
+  std::sort(expected.begin(), expected.end());
+  sort_strings(tokens);
+  EXPECT_EQ(tokens, expected);
+
+  const auto unique = unique_strings(tokens);
+  expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+  EXPECT_TRUE(std::equal(unique.begin(), unique.end(), expected.begin(), expected.end()));
+}
+
+static size_t naive_edit_distance(string_view a, string_view b, bool ignore_case)
+{
+  std::vector<size_t> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j) row[j] = j;
+  for (size_t i = 1; i <= a.size(); ++i)
+  {
+    size_t diagonal = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= b.size(); ++j)
+    {
+      const bool same = ignore_case ? ascii::toupper(a[i - 1]) == ascii::toupper(b[j - 1]) : a[i - 1] == b[j - 1];
+      const auto next = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (same ? 0 : 1) });
+      diagonal = row[j];
+      row[j] = next;
+    }
+  }
+  return row[b.size()];
+}
+
+TEST(edit_distance, matches_naive_implementation)
+{
+  EXPECT_EQ(edit_distance("kitten", "sitting"), 3u);
+  EXPECT_EQ(edit_distance("", "abc"), 3u);
+  EXPECT_EQ(edit_distance("Config", "config"), 1u);
+  EXPECT_EQ(edit_distance("Config", "config", true), 0u);
+
+  uint32_t seed = 7;
+  const auto random_string = [&](size_t length) {
+    std::string result;
+    for (size_t i = 0; i < length; ++i)
+    {
+      seed = seed * 1664525 + 1013904223;
+      result += "abcAB"[(seed >> 16) % 5];
+    }
+    return result;
+  };
+  for (size_t la : { 0, 1, 5, 63, 64, 65, 130, 200 })
+  {
+    for (size_t lb : { 0, 3, 64, 70, 129 })
+    {
+      const auto a = random_string(la), b = random_string(lb);
+      for (bool ignore_case : { false, true })
+      {
+        const auto expected = naive_edit_distance(a, b, ignore_case);
+        EXPECT_EQ(edit_distance(a, b, ignore_case), expected) << a << " / " << b;
+        EXPECT_EQ(bounded_edit_distance(a, b, expected, ignore_case), expected);
+        if (expected > 0)
+        {
+          EXPECT_EQ(bounded_edit_distance(a, b, expected - 1, ignore_case), expected);
+        }
+      }
+    }
+  }
+}
+
+TEST(fuzzy_index, finds_the_same_matches_as_brute_force)
+{
+  std::vector<std::string> words;
+  uint32_t seed = 99;
+  for (int i = 0; i < 20000; ++i)
+  {
+    std::string word;
+    for (int len = 3 + (seed >> 29); len > 0; --len)
+    {
+      seed = seed * 1664525 + 1013904223;
+      word += "etaoinshrdlu"[(seed >> 16) % 12];
+    }
+    words.push_back(std::move(word));
+  }
+  words.push_back("verbose_logging");
+  words.push_back("Verbose_Logging");
+
+  const fuzzy_index index{ words };
+  const fuzzy_index folded{ words, true };
+  EXPECT_EQ(index.size(), words.size());
+
+  const auto top = index.closest("verbos_loging", 3, 3);
+  ASSERT_FALSE(top.empty());
+  EXPECT_EQ(top[0].word, "verbose_logging");
+  EXPECT_EQ(top[0].distance, 2u);
+  EXPECT_EQ(folded.closest("VERBOSE_LOGGING", 2, 0).size(), 2u);
+
+  for (string_view query : { "stone", "hello", "ta", "unroll", "shoreline" })
+  {
+    for (size_t max_distance : { 0, 1, 2, 4 })
+    {
+      std::vector<std::pair<size_t, size_t>> expected;
+      for (size_t i = 0; i < words.size(); ++i)
+        if (const auto d = naive_edit_distance(query, words[i], false); d <= max_distance)
+          expected.emplace_back(d, i);
+      std::sort(expected.begin(), expected.end());
+      expected.resize(std::min<size_t>(expected.size(), 5));
+
+      const auto found = index.closest(query, 5, max_distance);
+      ASSERT_EQ(found.size(), expected.size()) << query << " " << max_distance;
+      for (size_t i = 0; i < found.size(); ++i)
+      {
+        EXPECT_EQ(found[i].distance, expected[i].first);
+        EXPECT_EQ(found[i].index, expected[i].second);
+        EXPECT_EQ(found[i].word, words[found[i].index]);
+      }
+    }
+  }
+}
+
+TEST(fuzzy_index, unlimited_distance_returns_every_word)
+{
+  const std::vector<std::string> words{ "kitten", "sitting", "", "a rather long entry", "mitten", "kitten" };
+  const fuzzy_index index{ words };
+
+  for (string_view query : { "kitten", "", "an even longer query than any of the words" })
+  {
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t i = 0; i < words.size(); ++i)
+      expected.emplace_back(naive_edit_distance(query, words[i], false), i);
+    std::sort(expected.begin(), expected.end());
+
+    const auto found = index.closest(query, words.size() + 10, SIZE_MAX);
+    ASSERT_EQ(found.size(), words.size()) << query;
+    for (size_t i = 0; i < found.size(); ++i)
+    {
+      EXPECT_EQ(found[i].distance, expected[i].first);
+      EXPECT_EQ(found[i].index, expected[i].second);
+    }
+  }
+}
+
+TEST(stats, snapshot_covers_all_threads_since_reset)
+{
+  stats::reset();
+  (void)ascii::tolower(string_view{ "Hello" });
+  std::thread{ [] { (void)hex_encode("abc"); } }.join();
+
+  const auto report = stats::snapshot();
+  std::stringstream dump;
+  stats::dump(dump, report);
+
+  if constexpr (GHASSANPL_STRING_OPS_STATS)
+  {
+    EXPECT_EQ(report[stats::function_id::tolower].calls, 1);
+    EXPECT_EQ(report[stats::function_id::tolower].bytes, 5);
+    EXPECT_EQ(report[stats::function_id::hex_encode].calls, 1);
+    EXPECT_EQ(report[stats::function_id::hex_encode].bytes, 3);
+    EXPECT_NE(dump.str().find("hex_encode calls=1 bytes=3 "), std::string::npos);
+
+    stats::reset();
+    EXPECT_EQ(stats::snapshot()[stats::function_id::tolower].calls, 0);
+
+    const std::vector<std::string> fields(50, std::string(40, 'x'));
+    (void)join(fields, ", ");
+    std::string joined;
+    join(fields, ", ", joined);
+    EXPECT_EQ(stats::snapshot()[stats::function_id::join].calls, 2);
+    EXPECT_EQ(stats::snapshot()[stats::function_id::join].bytes, 2 * (50 * 40 + 49 * 2));
+    EXPECT_EQ(stats::snapshot()[stats::function_id::join].allocations, 3);
+  }
+  else
+  {
+    EXPECT_EQ(report[stats::function_id::tolower].calls, 0);
+    EXPECT_TRUE(dump.str().empty());
+  }
+}
+
+TEST(whitespace, trims_and_collapses_like_the_scalar_definition)
+{
+  constexpr char alphabet[] = " \t\n\v\f\rab\x85\xA0";
+  uint32_t seed = 7;
+  std::vector<std::string> samples;
+  for (int i = 0; i < 3000; ++i)
+  {
+    std::string str;
+    seed = seed * 1664525 + 1013904223;
+    const auto length = (seed >> 8) % 70;
+    for (size_t j = 0; j < length; ++j)
+    {
+      seed = seed * 1664525 + 1013904223;
+      /// Mostly whitespace, so that runs cross 16-byte boundaries
+      str += alphabet[(seed >> 16) % ((seed >> 28) < 12 ? 6 : sizeof(alphabet) - 1)];
+    }
+    samples.push_back(std::move(str));
+  }
+
+  std::vector<string_view> fields(samples.begin(), samples.end());
+  trim_all(fields);
+
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    const string_view str = samples[i];
+    const auto first = std::find_if_not(str.begin(), str.end(), ascii::isspace);
+    const auto last = std::find_if_not(str.rbegin(), str.rend(), ascii::isspace).base();
+    const auto expected = first < last ? make_sv(first, last) : string_view{};
+    EXPECT_EQ(trimmed_whitespace(str), expected);
+    EXPECT_EQ(trimmed_whitespace_left(str), make_sv(first, str.end()));
+    EXPECT_EQ(trimmed_whitespace_right(str), make_sv(str.begin(), last));
+    EXPECT_EQ(fields[i], expected);
+    if (!expected.empty()) { EXPECT_EQ(fields[i].data(), expected.data()); }
+
+    std::string collapsed;
+    bool in_run = false;
+    for (const char c : str)
+    {
+      if (!ascii::isspace(c) || !in_run)
+        collapsed += ascii::isspace(c) ? ' ' : c;
+      in_run = ascii::isspace(c);
+    }
+    EXPECT_EQ(collapsed_whitespace(str), collapsed);
+    auto in_place = samples[i];
+    EXPECT_EQ(collapse_whitespace(in_place), collapsed);
+  }
+}
+
+enum class test_token { kw_if, kw_else, identifier, integer, floating, string, equals, punctuation };
+constexpr auto test_lexer = lex::compile([] {
+  using namespace lex;
+  return std::vector<rule>{
+    literal("if"), literal("else"), c_identifier(), c_integer(), c_float(), c_string(), literal("=="), pattern{ char_set{ "=+-*/(){};" } },
+    skip(whitespace()), skip(literal("//") + zero_or_more(~char_set{ '\n' })),
+  };
+});
+
+TEST(lexer, tokenizes_with_longest_match_and_rule_priority)
+{
+  using namespace std::string_view_literals;
+  std::vector<lex::token> tokens;
+  const auto rest = test_lexer.tokenize("if (x1 == -12) { y = 3.5e2; s = \"a\\\"b\"; } // done\nelse ifx 1e"sv, tokens);
+  EXPECT_TRUE(rest.empty());
+
+  const std::pair<test_token, string_view> expected[] = {
+    { test_token::kw_if, "if" }, { test_token::punctuation, "(" }, { test_token::identifier, "x1" }, { test_token::equals, "==" },
+    { test_token::integer, "-12" }, { test_token::punctuation, ")" }, { test_token::punctuation, "{" }, { test_token::identifier, "y" },
+    { test_token::punctuation, "=" }, { test_token::floating, "3.5e2" }, { test_token::punctuation, ";" }, { test_token::identifier, "s" },
+    { test_token::punctuation, "=" }, { test_token::string, "\"a\\\"b\"" }, { test_token::punctuation, ";" }, { test_token::punctuation, "}" },
+    { test_token::kw_else, "else" }, { test_token::identifier, "ifx" }, { test_token::integer, "1" }, { test_token::identifier, "e" },
+  };
+  ASSERT_EQ(tokens.size(), std::size(expected));
+  for (size_t i = 0; i < tokens.size(); ++i)
+  {
+    EXPECT_EQ(test_token(tokens[i].kind), expected[i].first) << i;
+    EXPECT_EQ(tokens[i].text, expected[i].second) << i;
+  }
+
+  auto literal = tokens[13].text;
+  EXPECT_EQ(consume_c_string(literal).second, "a\"b");
+
+  string_view bad = "x = #"sv;
+  EXPECT_TRUE(test_lexer.consume(bad));
+  EXPECT_TRUE(test_lexer.consume(bad));
+  EXPECT_FALSE(test_lexer.consume(bad));
+  EXPECT_EQ(bad, "#");
+  EXPECT_EQ(test_lexer.tokenize("a \"unterminated", [](lex::token) {}), "\"unterminated");
+}
+
+TEST(lexer, agrees_with_consume_functions)
+{
+  constexpr auto lexer = lex::compile([] { return std::vector<lex::rule>{ lex::c_identifier(), lex::c_integer() }; });
+  constexpr char alphabet[] = "aZ_09-";
+  uint32_t seed = 3;
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::string str;
+    seed = seed * 1664525 + 1013904223;
+    for (size_t j = 0, length = (seed >> 8) % 8; j < length; ++j)
+    {
+      seed = seed * 1664525 + 1013904223;
+      str += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+
+    string_view identifier = str, integer = str;
+    const auto expected_identifier = consume_c_identifier(identifier);
+    const auto expected_integer = consume_c_integer(integer).first;
+    const auto token = lexer.match(str);
+    if (!expected_identifier.empty())
+      EXPECT_EQ(token.text, expected_identifier) << str;
+    else if (!expected_integer.empty())
+      EXPECT_EQ(token.text, expected_integer) << str;
+    else
+      EXPECT_FALSE(token) << str;
+  }
+}
+
+/// Straightforward backtracking reference
+static bool naive_glob(string_view pattern, string_view str, bool ignore_case)
+{
+  if (pattern.empty())
+    return str.empty();
+  if (pattern[0] == '*')
+  {
+    for (size_t skip = 0; skip <= str.size(); ++skip)
+      if (naive_glob(pattern.substr(1), str.substr(skip), ignore_case))
+        return true;
+    return false;
+  }
+  if (str.empty())
+    return false;
+  const auto fold = [&](char c) { return ignore_case ? char(ascii::tolower(c)) : c; };
+  if (pattern[0] == '?')
+    return naive_glob(pattern.substr(1), str.substr(1), ignore_case);
+  if (pattern[0] == '[')
+  {
+    const bool negated = pattern[1] == '!';
+    const auto close = pattern.find(']', negated ? 3 : 2);
+    bool found = false;
+    for (size_t i = negated ? 2 : 1; i < close; ++i)
+    {
+      if (i + 2 < close && pattern[i + 1] == '-')
+      {
+        found |= fold(str[0]) >= fold(pattern[i]) && fold(str[0]) <= fold(pattern[i + 2]);
+        i += 2;
+      }
+      else
+        found |= fold(str[0]) == fold(pattern[i]);
+    }
+    return found != negated && naive_glob(pattern.substr(close + 1), str.substr(1), ignore_case);
+  }
+  return fold(pattern[0]) == fold(str[0]) && naive_glob(pattern.substr(1), str.substr(1), ignore_case);
+}
+
+TEST(glob_pattern, matches_like_a_backtracking_matcher)
+{
+  constexpr string_view pattern_atoms[] = { "a", "b", "B", ".", "*", "*", "?", "[a-b]", "[ax]", "[!a]", "[!A-B]" };
+  constexpr char text_alphabet[] = "abAB.x";
+  uint32_t seed = 11;
+  auto next = [&](uint32_t bound) { seed = seed * 1664525 + 1013904223; return (seed >> 8) % bound; };
+
+  for (int p = 0; p < 300; ++p)
+  {
+    std::string pattern;
+    for (size_t i = 0, length = next(7); i < length; ++i)
+      pattern += pattern_atoms[next(std::size(pattern_atoms))];
+
+    const glob_pattern sensitive{ pattern }, insensitive{ pattern, true };
+    std::vector<std::string> texts;
+    for (int t = 0; t < 40; ++t)
+    {
+      std::string text;
+      for (size_t i = 0, length = next(9); i < length; ++i)
+        text += text_alphabet[next(sizeof(text_alphabet) - 1)];
+      texts.push_back(std::move(text));
+    }
+
+    std::vector<string_view> views(texts.begin(), texts.end());
+    std::vector<bool> results;
+    const auto count = sensitive.match_all(views, results);
+    size_t expected_count = 0;
+    for (size_t t = 0; t < texts.size(); ++t)
+    {
+      const bool expected = naive_glob(pattern, texts[t], false);
+      expected_count += expected;
+      EXPECT_EQ(sensitive.match(texts[t]), expected) << pattern << " " << texts[t];
+      EXPECT_EQ(results[t], expected) << pattern << " " << texts[t];
+      EXPECT_EQ(insensitive.match(texts[t]), naive_glob(pattern, texts[t], true)) << pattern << " " << texts[t];
+    }
+    EXPECT_EQ(count, expected_count);
+  }
+}
+
+TEST(glob_pattern, handles_sets_escapes_and_pathological_patterns)
+{
+  EXPECT_TRUE(glob_pattern{ "user_??_*" }.match("user_42_admin"));
+  EXPECT_FALSE(glob_pattern{ "user_??_*" }.match("user_4_admin"));
+  EXPECT_TRUE(glob_pattern{ "[!0-9]*" }.match("x1"));
+  EXPECT_FALSE(glob_pattern{ "[^0-9]*" }.match("1x"));
+  EXPECT_TRUE(glob_pattern{ "[]a]" }.match("]"));
+  EXPECT_TRUE(glob_pattern{ "\\*\\?" }.match("*?"));
+  EXPECT_FALSE(glob_pattern{ "\\*" }.match("a"));
+  EXPECT_TRUE(glob_pattern{ "[abc" }.match("[abc"));
+  EXPECT_TRUE((glob_pattern{ "*.LOG", true }.match("server.log")));
+  EXPECT_EQ((glob_pattern{ "*error*.Log", true }.required_literal()), "error");
+  EXPECT_FALSE((glob_pattern{ "[!a]", true }.match("a")));
+  EXPECT_FALSE((glob_pattern{ "[!a]", true }.match("A")));
+  EXPECT_TRUE((glob_pattern{ "[!a]", true }.match("b")));
+  EXPECT_FALSE((glob_pattern{ "[!a-z]*", true }.match("hello")));
+  EXPECT_FALSE((glob_pattern{ "[^A-Z]*", true }.match("Hello")));
+  EXPECT_TRUE((glob_pattern{ "[!a-z]*", true }.match("_hello")));
+
+  const std::string as(100000, 'a');
+  EXPECT_FALSE(glob_pattern{ "*a*a*a*a*a*a*a*a*b" }.match(as));
+  EXPECT_TRUE(glob_pattern{ "a*a*a*a*a*a*a*a*a" }.match(as));
+}
+
+TEST(string_column, stores_split_and_consumed_fields_contiguously)
+{
+  string_column column;
+  split(" 12, -7 ,x, 40000000000,,0x10", ',', column);
+  natural_split("A  b", ' ', column);
+  string_view source = R"("Tab\tEnd" "\x41é" "bad\q")";
+  EXPECT_FALSE(consume_c_string(source, column).empty());
+  source.remove_prefix(1);
+  EXPECT_FALSE(consume_c_string(source, column).empty());
+  source.remove_prefix(1);
+  EXPECT_TRUE(consume_c_string(source, column).empty());
+
+  const std::vector<string_view> expected{ " 12", " -7 ", "x", " 40000000000", "", "0x10", "A", "b", "Tab\tEnd", "A\xC3\xA9" };
+  ASSERT_EQ(column.size(), expected.size());
+  EXPECT_TRUE(std::ranges::equal(column, expected));
+  EXPECT_EQ(column.offsets().size(), column.size() + 1);
+  EXPECT_EQ(column.bytes().size(), column.offsets().back());
+  EXPECT_EQ(column.back(), "A\xC3\xA9");
+
+  trim_all(column);
+  EXPECT_EQ(column[0], "12");
+  EXPECT_EQ(column[1], "-7");
+  EXPECT_EQ(column[8], "Tab\tEnd");
+  EXPECT_EQ(column.bytes(), "12-7x400000000000x10AbTab\tEndA\xC3\xA9");
+
+  std::vector<int32_t> values(column.size(), 99);
+  EXPECT_EQ(parse_integers(column, std::span{ values }), 2u);
+  EXPECT_EQ(values, (std::vector<int32_t>{ 12, -7, 0, 0, 0, 0, 0, 0, 0, 0 }));
+
+  ascii::toupper(column);
+  EXPECT_EQ(column[2], "X");
+  ascii::tolower(column);
+  EXPECT_EQ(column[6], "a");
+  EXPECT_EQ(column[9], "a\xC3\xA9");
+
+  column.pop_back();
+  EXPECT_EQ(column.back(), "tab\tend");
+  column.clear();
+  EXPECT_TRUE(column.empty());
+  EXPECT_TRUE(column.bytes().empty());
+}
+
+TEST(string_column, batch_transforms_match_per_field_results_in_parallel)
+{
+  large_string_column column;
+  std::vector<std::string> fields;
+  for (int i = 0; i < 200000; ++i)
+    fields.push_back((i % 3 ? " Item" : "\t") + std::to_string(i * 7919 - 500000) + (i % 5 ? "Z " : " "));
+  for (auto const& field : fields)
+    column.push_back(field);
+
+  ascii::tolower(column);
+  trim_all(column);
+  std::vector<int64_t> values(column.size());
+  const auto parsed = parse_integers(column, std::span{ values });
+
+  size_t expected_parsed = 0;
+  for (size_t i = 0; i < fields.size(); ++i)
+  {
+    const auto expected = std::string{ trimmed_whitespace(ascii::tolower(string_view{ fields[i] })) };
+    ASSERT_EQ(column[i], expected);
+    int64_t value = 0;
+    const bool ok = std::from_chars(expected.data(), expected.data() + expected.size(), value).ptr == expected.data() + expected.size();
+    expected_parsed += ok;
+    ASSERT_EQ(values[i], ok ? value : 0);
+  }
+  EXPECT_EQ(parsed, expected_parsed);
+}
+
+TEST(small_strings, behave_like_std_string_across_the_inline_limit)
+{
+  static_assert(sizeof(compact_string) == 24 && sizeof(inline_string<23>) == 24 && sizeof(inline_string<7>) == 8);
+
+  compact_string compact;
+  inline_string<23> small;
+  std::string reference;
+  for (int i = 0; i < 60; ++i)
+  {
+    const char c = char('a' + i % 26);
+    compact.push_back(c);
+    reference.push_back(c);
+    if (i < 23)
+      small.push_back(c);
+    ASSERT_EQ(compact.view(), reference);
+    ASSERT_EQ(std::strlen(compact.c_str()), reference.size());
+    ASSERT_EQ(compact.heap_allocated(), reference.size() > 23);
+
+    const compact_string copy{ reference };
+    EXPECT_EQ(copy, compact);
+    EXPECT_EQ(copy.hash(), compact.hash());
+    if (i < 23)
+    {
+      EXPECT_EQ(small, string_view{ reference });
+      EXPECT_EQ(std::strlen(small.c_str()), reference.size());
+      EXPECT_EQ(small.hash(), compact.hash());
+    }
+  }
+  EXPECT_THROW(small.push_back('x'), std::length_error);
+
+  for (string_view str : { "", "a", "identifier", "twenty-three characters", "a string longer than twenty-three characters" })
+  {
+    const auto expected = compact_string{ str }.hash();
+    if (str.size() <= 10) { EXPECT_EQ(inline_string<10>{ str }.hash(), expected); }
+    if (str.size() <= 23) { EXPECT_EQ(inline_string<23>{ str }.hash(), expected); }
+    EXPECT_EQ(inline_string<64>{ str }.hash(), expected);
+  }
+
+  /// A heap string shrunk back to a short one still equals (and hashes like) an inline one
+  compact.resize(5);
+  EXPECT_TRUE(compact.heap_allocated());
+  EXPECT_EQ(compact, compact_string{ "abcde" });
+  EXPECT_EQ(compact.hash(), compact_string{ "abcde" }.hash());
+  EXPECT_NE(compact, compact_string{ "abcdf" });
+  EXPECT_LT(compact, "abcdf");
+
+  compact.append(compact);
+  EXPECT_EQ(compact, "abcdeabcde");
+  compact_string moved = std::move(compact);
+  EXPECT_TRUE(compact.empty());
+  EXPECT_EQ(moved, "abcdeabcde");
+  moved = compact_string{ std::string(40, 'z') };
+  moved = moved;
+  EXPECT_EQ(moved, std::string(40, 'z'));
+
+  std::unordered_set<compact_string> set;
+  set.insert(compact_string{ "identifier" });
+  set.insert(compact_string{ "a rather long string that lives on the heap" });
+  EXPECT_TRUE(set.contains(compact_string{ "identifier" }));
+  EXPECT_FALSE(set.contains(compact_string{ "identifie" }));
+}
+
+TEST(small_strings, are_filled_by_make_string_tolower_and_consume_c_string)
+{
+  const string_view source = "Hello, World";
+  EXPECT_EQ(make_string<inline_string<5>>(source.begin(), source.begin() + 5), "Hello");
+  EXPECT_EQ(make_string<compact_string>(source.begin(), source.end()), source);
+  EXPECT_THROW((void)make_string<inline_string<5>>(source.begin(), source.end()), std::length_error);
+
+  inline_string<16> lower;
+  EXPECT_EQ(ascii::tolower(source, lower), "hello, world");
+  compact_string upper;
+  EXPECT_EQ(ascii::toupper(source, upper), "HELLO, WORLD");
+
+  string_view literals = R"("tab\there" "ét\x7e" "a long literal that will not fit")";
+  inline_string<10> decoded;
+  EXPECT_EQ(consume_c_string(literals, decoded), R"("tab\there")");
+  EXPECT_EQ(decoded, "tab\there");
+  literals.remove_prefix(1);
+  decoded.clear();
+  EXPECT_FALSE(consume_c_string(literals, decoded).empty());
+  EXPECT_EQ(decoded, "\xC3\xA9t~");
+  literals.remove_prefix(1);
+
+  const auto before = literals;
+  EXPECT_TRUE(consume_c_string(literals, decoded).empty());
+  EXPECT_EQ(literals, before);
+  EXPECT_EQ(decoded, "\xC3\xA9t~");
+
+  compact_string long_decoded{ "> " };
+  EXPECT_FALSE(consume_c_string(literals, long_decoded).empty());
+  EXPECT_EQ(long_decoded, "> a long literal that will not fit");
+  EXPECT_TRUE(literals.empty());
+}
+
+constexpr auto test_keywords = make_keyword_set("if", "else", "elif", "while", "for", "return", "<", "<=", "<<", "<<=", "=", "==", "content_length", "content_type", "");
+static_assert(test_keywords.lookup("elif") == 2 && test_keywords.lookup("<<=") == 9 && test_keywords.lookup("") == 14);
+static_assert(test_keywords.lookup("eliff") == string_view::npos && test_keywords.lookup("If") == string_view::npos);
+
+TEST(keyword_set, finds_exactly_the_keywords)
+{
+  const auto keywords = test_keywords.keywords();
+  for (size_t i = 0; i < keywords.size(); ++i)
+  {
+    EXPECT_EQ(test_keywords.lookup(keywords[i]), i);
+    std::string changed{ keywords[i] };
+    for (size_t j = 0; j < changed.size(); ++j)
+    {
+      changed[j] ^= 1;
+      const auto found = std::ranges::find(keywords, changed);
+      EXPECT_EQ(test_keywords.lookup(changed), found == keywords.end() ? string_view::npos : size_t(found - keywords.begin()));
+      changed[j] ^= 1;
+    }
+    EXPECT_EQ(test_keywords.lookup(changed + "x"), string_view::npos);
+  }
+
+  string_view source = "<<=x <= content_types";
+  EXPECT_EQ(consume_one_of(source, test_keywords), 9u);
+  EXPECT_EQ(source, "x <= content_types");
+  EXPECT_EQ(consume_one_of(source, test_keywords), 14u); /// the empty keyword
+  source.remove_prefix(2);
+  EXPECT_EQ(consume_one_of(source, test_keywords), 7u);
+  source.remove_prefix(1);
+  EXPECT_EQ(consume_one_of(source, test_keywords), 13u);
+  EXPECT_EQ(source, "s");
+
+  constexpr auto no_empty = make_keyword_set("while", "when", "where");
+  source = "wh";
+  EXPECT_EQ(consume_one_of(source, no_empty), string_view::npos);
+  EXPECT_EQ(source, "wh");
+}
+
+TEST(keyword_set, ignore_case_folds_only_ascii_letters)
+{
+  constexpr auto methods = make_keyword_set_ignore_case("GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH", "[at]");
+  static_assert(methods.ignores_case() && methods.lookup("get") == 0 && methods.lookup("Patch") == 8);
+  EXPECT_EQ(methods.lookup("dElEtE"), 4u);
+  EXPECT_EQ(methods.lookup("[AT]"), 9u);
+  EXPECT_EQ(methods.lookup("{at}"), string_view::npos);
+  EXPECT_EQ(methods.lookup("GETS"), string_view::npos);
+
+  string_view request = "options * HTTP/1.1";
+  EXPECT_EQ(consume_one_of(request, methods), 6u);
+  EXPECT_EQ(request, " * HTTP/1.1");
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);